@@ -17,6 +17,7 @@ typedef struct image {
     size_t width;
     size_t height;
     pixel_t* pixels;
+    size_t capacity; /* bytes mapped for huge page buffers, 0 when malloc'd */
 } image_t;
 
 static inline pixel_t* image_get_pixel(image_t* image, unsigned int x, unsigned int y) {
@@ -27,18 +28,46 @@ static inline pixel_t* image_get_pixel(image_t* image, unsigned int x, unsigned
     return &image->pixels[x + y * image->width];
 }
 
+typedef enum image_alloc {
+    IMAGE_ALLOC_MALLOC,
+    IMAGE_ALLOC_HUGE_PAGES,
+} image_alloc_t;
+
+/* how pixel buffers are allocated, huge page buffers are recycled through a pool */
+extern image_alloc_t image_alloc_mode;
+
+/* touch every page of new images from the creating thread (NUMA first-touch) */
+extern bool image_first_touch;
+
 image_t* image_create(size_t id, size_t width, size_t height);
 image_t* image_create_from_png(char* filename);
 image_t* image_copy(image_t* image);
 void image_destroy(image_t* image);
+void image_pool_release(void);
 int image_save_png(image_t* image, char* filename);
 
+typedef struct image_dir_entry {
+    char* name;
+    size_t id;
+    off_t size;
+} image_dir_entry_t;
+
+typedef enum image_dir_order {
+    IMAGE_DIR_ORDER_NAME,
+    IMAGE_DIR_ORDER_SIZE,
+} image_dir_order_t;
+
 typedef struct image_dir {
     const char* input_dir_name;
     const char* output_dir_name;
     const char* save_prefix;
     size_t load_current;
-    bool stop;
+    bool stop;   /* stop loading, let in-flight images finish */
+    bool cancel; /* also drop in-flight images without filtering them */
+
+    /* manifest built by image_dir_index(), NULL when probing `%04ld.png` */
+    image_dir_entry_t* entries;
+    size_t entry_count;
 } image_dir_t;
 
 image_t* image_dir_load_next(image_dir_t* image_dir);
@@ -47,4 +76,8 @@ int image_dir_save(image_dir_t* image_dir, image_t* image);
 void image_dir_reset(image_dir_t* image_dir, const char* input_dir_name, const char* output_dir_name,
                      const char* save_prefix);
 
+/* scan the input directory once and load frames from the resulting manifest */
+int image_dir_index(image_dir_t* image_dir, image_dir_order_t order);
+void image_dir_index_free(image_dir_t* image_dir);
+
 #endif /* INCLUDE_IMAGE_H_ */
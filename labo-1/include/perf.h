@@ -0,0 +1,78 @@
+#ifndef INCLUDE_PERF_H_
+#define INCLUDE_PERF_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+/* collect hardware counters and report them after the run, set by `--perf` */
+extern bool perf_enabled;
+
+typedef enum perf_counter_kind {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_LLC_MISSES,
+    PERF_COUNTER_DTLB_MISSES,
+    PERF_COUNTER_MAX,
+} perf_counter_kind_t;
+
+/* hardware counters of the calling thread, a counter is unavailable when its fd is -1 */
+typedef struct perf_counters {
+    int fds[PERF_COUNTER_MAX];
+} perf_counters_t;
+
+typedef struct perf_values {
+    bool valid[PERF_COUNTER_MAX];
+    unsigned long long counts[PERF_COUNTER_MAX];
+} perf_values_t;
+
+/*
+ * With `inherit`, threads created afterwards are counted once they have
+ * exited. Counts are scaled by time enabled over time running when the
+ * kernel multiplexes more counters than the hardware has.
+ */
+void perf_counters_open(perf_counters_t* counters, bool inherit);
+void perf_counters_close(perf_counters_t* counters);
+void perf_counters_read(perf_counters_t* counters, perf_values_t* values);
+
+/* `delta` may alias `end` */
+void perf_values_diff(perf_values_t* start, perf_values_t* end, perf_values_t* delta);
+
+typedef enum perf_stage_kind {
+    PERF_STAGE_LOAD,
+    PERF_STAGE_SCALE,
+    PERF_STAGE_SHARPEN,
+    PERF_STAGE_SOBEL,
+    PERF_STAGE_SAVE,
+    PERF_STAGE_MAX,
+} perf_stage_kind_t;
+
+/* totals of every image that went through a stage, summed over its threads */
+typedef struct perf_stage {
+    const char* name;
+    pthread_mutex_t mutex;
+    size_t images;
+    unsigned long long time_us;
+    perf_values_t values;
+} perf_stage_t;
+
+extern perf_stage_t perf_stages[PERF_STAGE_MAX];
+
+/* per-thread probe measuring one image at a time, does nothing unless perf_enabled */
+typedef struct perf_probe {
+    perf_counters_t counters;
+    perf_values_t start_values;
+    struct timespec start_time;
+} perf_probe_t;
+
+void perf_probe_open(perf_probe_t* probe);
+void perf_probe_close(perf_probe_t* probe);
+void perf_probe_begin(perf_probe_t* probe);
+void perf_probe_end(perf_probe_t* probe, perf_stage_kind_t stage);
+
+/* prints the run and its stages as CSV, unavailable counters are left empty */
+void perf_report(FILE* file, const char* pipeline, unsigned long long time_us, perf_values_t* values);
+
+#endif /* INCLUDE_PERF_H_ */
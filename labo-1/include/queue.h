@@ -4,6 +4,7 @@
 #define INCLUDE_QUEUE_H_
 
 #include <pthread.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "queue.h"
@@ -23,11 +24,19 @@ typedef struct queue {
     pthread_mutex_t mutex;
     pthread_cond_t modified_item_pushed;
     pthread_cond_t modified_item_poped;
+    bool closed;
 } queue_t;
 
+/* returned by queue_pop_value() once the queue is closed and empty */
+#define QUEUE_CLOSED 1
+
 queue_t* queue_create(size_t size);
 void queue_destroy(queue_t* queue);
 int queue_push(queue_t* queue, void* ptr);
 void* queue_pop(queue_t* queue);
 
+/* wakes every waiter, pushes then fail and pops return what is left before QUEUE_CLOSED */
+void queue_close(queue_t* queue);
+int queue_pop_value(queue_t* queue, void** value);
+
 #endif /* INCLUDE_QUEUE_H_ */
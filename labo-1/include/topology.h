@@ -0,0 +1,42 @@
+#ifndef INCLUDE_TOPOLOGY_H_
+#define INCLUDE_TOPOLOGY_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* pin pipeline workers to NUMA nodes, set by `--numa` */
+extern bool topology_pinning;
+
+typedef struct topology_node {
+    unsigned int id;
+    int* cpus;
+    size_t cpu_count;
+} topology_node_t;
+
+typedef struct topology {
+    topology_node_t* nodes;
+    size_t node_count;
+} topology_t;
+
+/* page allocation counters of a node, see /sys/devices/system/node/nodeN/numastat */
+typedef struct topology_numastat {
+    unsigned long long local;
+    unsigned long long remote;
+    /* false when the counters could not be read */
+    bool available;
+} topology_numastat_t;
+
+/* falls back to a single node holding every online CPU when sysfs is not available */
+int topology_discover(topology_t* topology);
+void topology_release(topology_t* topology);
+
+/* threads created with `attr` only run on the CPUs of `node` */
+int topology_attr_init(pthread_attr_t* attr, topology_node_t* node);
+
+/* fault image pages from the thread creating them so they stay on its node */
+void topology_enable_first_touch(void);
+
+int topology_numastat(topology_node_t* node, topology_numastat_t* numastat);
+
+#endif /* INCLUDE_TOPOLOGY_H_ */
@@ -1,12 +1,140 @@
 /* DO NOT EDIT THIS FILE */
 
+#include <fcntl.h>
 #include <png.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "image.h"
 #include "log.h"
 
+#define IMAGE_POOL_SIZE 32
+
+static const size_t IMAGE_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+typedef struct image_pool_entry {
+    void* pixels;
+    size_t capacity;
+} image_pool_entry_t;
+
+typedef struct image_pool {
+    pthread_mutex_t mutex;
+    image_pool_entry_t entries[IMAGE_POOL_SIZE];
+    size_t count;
+} image_pool_t;
+
+static image_pool_t image_pool = {.mutex = PTHREAD_MUTEX_INITIALIZER, .count = 0};
+
+image_alloc_t image_alloc_mode = IMAGE_ALLOC_MALLOC;
+bool image_first_touch         = false;
+
+/* takes the smallest pooled buffer able to hold `capacity` bytes */
+static void* image_pool_take(size_t capacity, size_t* taken_capacity) {
+    void* pixels = NULL;
+
+    pthread_mutex_lock(&image_pool.mutex);
+
+    size_t best = image_pool.count;
+    for (size_t i = 0; i < image_pool.count; i++) {
+        if (image_pool.entries[i].capacity >= capacity &&
+            (best == image_pool.count || image_pool.entries[i].capacity < image_pool.entries[best].capacity)) {
+            best = i;
+        }
+    }
+
+    if (best < image_pool.count) {
+        pixels                   = image_pool.entries[best].pixels;
+        *taken_capacity          = image_pool.entries[best].capacity;
+        image_pool.entries[best] = image_pool.entries[--image_pool.count];
+    }
+
+    pthread_mutex_unlock(&image_pool.mutex);
+
+    return pixels;
+}
+
+static bool image_pool_give(void* pixels, size_t capacity) {
+    bool given = false;
+
+    pthread_mutex_lock(&image_pool.mutex);
+
+    if (image_pool.count < IMAGE_POOL_SIZE) {
+        image_pool.entries[image_pool.count++] = (image_pool_entry_t){.pixels = pixels, .capacity = capacity};
+        given                                  = true;
+    }
+
+    pthread_mutex_unlock(&image_pool.mutex);
+
+    return given;
+}
+
+void image_pool_release(void) {
+    pthread_mutex_lock(&image_pool.mutex);
+
+    for (size_t i = 0; i < image_pool.count; i++) {
+        munmap(image_pool.entries[i].pixels, image_pool.entries[i].capacity);
+    }
+    image_pool.count = 0;
+
+    pthread_mutex_unlock(&image_pool.mutex);
+}
+
+/*
+ * Maps `size` bytes on 2 MB pages. Explicit huge pages (MAP_HUGETLB) need pages
+ * reserved by the administrator; otherwise a 2 MB aligned mapping is requested
+ * as transparent huge pages with madvise(MADV_HUGEPAGE).
+ */
+static void* image_map_huge(size_t size, size_t* capacity) {
+    *capacity = (size + IMAGE_HUGE_PAGE_SIZE - 1) & ~(IMAGE_HUGE_PAGE_SIZE - 1);
+
+    /* pooled buffers were first touched by another thread, keep NUMA placement intact */
+    if (!image_first_touch) {
+        void* pixels = image_pool_take(*capacity, capacity);
+        if (pixels != NULL) {
+            return pixels;
+        }
+    }
+
+#ifdef MAP_HUGETLB
+    void* pixels = mmap(NULL, *capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pixels != MAP_FAILED) {
+        return pixels;
+    }
+#endif
+
+    size_t length = *capacity + IMAGE_HUGE_PAGE_SIZE;
+    char* raw     = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        LOG_ERROR_ERRNO("mmap");
+        return NULL;
+    }
+
+    char* aligned = (char*)(((uintptr_t)raw + IMAGE_HUGE_PAGE_SIZE - 1) & ~(IMAGE_HUGE_PAGE_SIZE - 1));
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    if (raw + length > aligned + *capacity) {
+        munmap(aligned + *capacity, (raw + length) - (aligned + *capacity));
+    }
+
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, *capacity, MADV_HUGEPAGE);
+#endif
+
+    return aligned;
+}
+
+static void image_unmap_huge(void* pixels, size_t capacity) {
+    if (image_first_touch || !image_pool_give(pixels, capacity)) {
+        munmap(pixels, capacity);
+    }
+}
+
 image_t* image_create(size_t id, size_t width, size_t height) {
     image_t* image = calloc(1, sizeof(*image));
     if (image == NULL) {
@@ -18,12 +146,27 @@ image_t* image_create(size_t id, size_t width, size_t height) {
     image->width  = width;
     image->height = height;
 
-    image->pixels = malloc((image->width * image->height) * sizeof(*image->pixels));
+    size_t size = (image->width * image->height) * sizeof(*image->pixels);
+    if (image_alloc_mode == IMAGE_ALLOC_HUGE_PAGES) {
+        image->pixels = image_map_huge(size, &image->capacity);
+    } else {
+        image->pixels = malloc(size);
+    }
+
     if (image->pixels == NULL) {
-        LOG_ERROR_ERRNO("malloc");
+        LOG_ERROR("failed to allocate pixels");
         goto fail_free_image;
     }
 
+    if (image_first_touch) {
+        long page_size       = sysconf(_SC_PAGESIZE);
+        unsigned char* bytes = (unsigned char*)image->pixels;
+
+        for (size_t offset = 0; offset < size; offset += page_size) {
+            bytes[offset] = 0;
+        }
+    }
+
     return image;
 
 fail_free_image:
@@ -189,7 +332,9 @@ fail_exit:
 }
 
 void image_destroy(image_t* image) {
-    if (image->pixels != NULL) {
+    if (image->pixels != NULL && image->capacity != 0) {
+        image_unmap_huge(image->pixels, image->capacity);
+    } else if (image->pixels != NULL) {
         free(image->pixels);
     }
     free(image);
@@ -295,6 +440,36 @@ fail_exit:
     return -1;
 }
 
+static image_t* image_dir_load_entry(image_dir_t* image_dir) {
+    const size_t buffer_size = 256;
+    char buffer[buffer_size];
+
+    /* the cursor is shared by every loader thread working on the manifest */
+    size_t index = __atomic_fetch_add(&image_dir->load_current, 1, __ATOMIC_RELAXED);
+    if (index >= image_dir->entry_count) {
+        goto fail_exit;
+    }
+
+    image_dir_entry_t* entry = &image_dir->entries[index];
+
+    int count = snprintf(buffer, buffer_size, "%s/%s", image_dir->input_dir_name, entry->name);
+    if (count >= buffer_size - 1) {
+        LOG_ERROR("buffer too small");
+        goto fail_exit;
+    }
+
+    image_t* image = image_create_from_png(buffer);
+    if (image == NULL) {
+        goto fail_exit;
+    }
+
+    image->id = entry->id;
+    return image;
+
+fail_exit:
+    return NULL;
+}
+
 image_t* image_dir_load_next(image_dir_t* image_dir) {
     const size_t buffer_size = 256;
     char buffer[buffer_size];
@@ -303,6 +478,10 @@ image_t* image_dir_load_next(image_dir_t* image_dir) {
         goto stop_exit;
     }
 
+    if (image_dir->entries != NULL) {
+        return image_dir_load_entry(image_dir);
+    }
+
     int count = snprintf(buffer, buffer_size, "%s/%04ld.png", image_dir->input_dir_name, image_dir->load_current);
     if (count >= buffer_size - 1) {
         LOG_ERROR("buffer too small");
@@ -356,4 +535,198 @@ void image_dir_reset(image_dir_t* image_dir, const char* input_dir_name, const c
     image_dir->output_dir_name = output_dir_name;
     image_dir->save_prefix     = save_prefix;
     image_dir->load_current    = 0;
+
+    image_dir_index_free(image_dir);
+}
+
+/* returns true if `stem` is non-empty and only made of decimal digits */
+static bool is_numeric(const char* stem, size_t len) {
+    if (len == 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        if (stem[i] < '0' || stem[i] > '9') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Accepts `*.png` files, except the ones image_dir_save() writes with the
+ * prefix of `image_dir` (`PREFIX-NNNN.png`) so that outputs are never fed
+ * back into the pipeline when the input and output directories are the
+ * same. Other names ending in `-NNNN.png` are regular inputs.
+ */
+static bool is_input_name(const image_dir_t* image_dir, const char* name) {
+    const char* suffix = ".png";
+    size_t len         = strlen(name);
+    size_t suffix_len  = strlen(suffix);
+
+    if (len <= suffix_len || strcmp(name + len - suffix_len, suffix) != 0) {
+        return false;
+    }
+
+    size_t prefix_len = strlen(image_dir->save_prefix);
+
+    if (len > prefix_len + 1 + suffix_len && strncmp(name, image_dir->save_prefix, prefix_len) == 0 &&
+        name[prefix_len] == '-' && is_numeric(name + prefix_len + 1, len - prefix_len - 1 - suffix_len)) {
+        return false;
+    }
+
+    return true;
+}
+
+static bool has_numeric_stem(const image_dir_entry_t* entry) {
+    return is_numeric(entry->name, strlen(entry->name) - strlen(".png"));
+}
+
+/* numeric names first in numeric order (`2.png` < `10.png`), then the rest in lexical order */
+static int compare_entry_name(const void* a, const void* b) {
+    const image_dir_entry_t* entry_a = a;
+    const image_dir_entry_t* entry_b = b;
+
+    bool numeric_a = has_numeric_stem(entry_a);
+    bool numeric_b = has_numeric_stem(entry_b);
+
+    if (numeric_a != numeric_b) {
+        return numeric_a ? -1 : 1;
+    }
+
+    if (numeric_a && entry_a->id != entry_b->id) {
+        return (entry_a->id < entry_b->id) ? -1 : 1;
+    }
+
+    return strcmp(entry_a->name, entry_b->name);
+}
+
+/* largest frames first so the slowest images do not end up last in the pipeline */
+static int compare_entry_size(const void* a, const void* b) {
+    const image_dir_entry_t* entry_a = a;
+    const image_dir_entry_t* entry_b = b;
+
+    if (entry_a->size != entry_b->size) {
+        return (entry_a->size > entry_b->size) ? -1 : 1;
+    }
+
+    return (entry_a->id < entry_b->id) ? -1 : (entry_a->id > entry_b->id);
+}
+
+int image_dir_index(image_dir_t* image_dir, image_dir_order_t order) {
+    image_dir_index_free(image_dir);
+
+    DIR* dir = opendir(image_dir->input_dir_name);
+    if (dir == NULL) {
+        LOG_ERROR_ERRNO("opendir");
+        goto fail_exit;
+    }
+
+    size_t capacity            = 64;
+    size_t count               = 0;
+    image_dir_entry_t* entries = malloc(capacity * sizeof(*entries));
+    if (entries == NULL) {
+        LOG_ERROR_ERRNO("malloc");
+        goto fail_close_dir;
+    }
+
+    struct dirent* dirent;
+    while ((dirent = readdir(dir)) != NULL) {
+        if (!is_input_name(image_dir, dirent->d_name)) {
+            continue;
+        }
+
+        struct stat info;
+        if (fstatat(dirfd(dir), dirent->d_name, &info, 0) < 0) {
+            LOG_ERROR_ERRNO("fstatat");
+            goto fail_free_entries;
+        }
+
+        if (!S_ISREG(info.st_mode)) {
+            continue;
+        }
+
+        if (count == capacity) {
+            image_dir_entry_t* new_entries = realloc(entries, 2 * capacity * sizeof(*entries));
+            if (new_entries == NULL) {
+                LOG_ERROR_ERRNO("realloc");
+                goto fail_free_entries;
+            }
+
+            entries = new_entries;
+            capacity *= 2;
+        }
+
+        image_dir_entry_t* entry = &entries[count];
+
+        entry->name = strdup(dirent->d_name);
+        if (entry->name == NULL) {
+            LOG_ERROR_ERRNO("strdup");
+            goto fail_free_entries;
+        }
+
+        entry->size = info.st_size;
+        entry->id   = has_numeric_stem(entry) ? strtoul(entry->name, NULL, 10) : 0;
+        count++;
+    }
+
+    if (count == 0) {
+        LOG_ERROR("no image found in directory `%s`", image_dir->input_dir_name);
+        goto fail_free_entries;
+    }
+
+    qsort(entries, count, sizeof(*entries), compare_entry_name);
+
+    /* numeric names keep their number as id, the others are numbered after them */
+    size_t next_id = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (has_numeric_stem(&entries[i])) {
+            /* `1.png` and `0001.png` sort side by side, both would be saved under the same output name */
+            if (i > 0 && has_numeric_stem(&entries[i - 1]) && entries[i - 1].id == entries[i].id) {
+                LOG_ERROR("`%s` and `%s` have the same frame number", entries[i - 1].name, entries[i].name);
+                goto fail_free_entries;
+            }
+
+            next_id = entries[i].id + 1;
+        } else {
+            entries[i].id = next_id++;
+        }
+    }
+
+    if (order == IMAGE_DIR_ORDER_SIZE) {
+        qsort(entries, count, sizeof(*entries), compare_entry_size);
+    }
+
+    closedir(dir);
+
+    image_dir->entries      = entries;
+    image_dir->entry_count  = count;
+    image_dir->load_current = 0;
+
+    return 0;
+
+fail_free_entries:
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i].name);
+    }
+    free(entries);
+fail_close_dir:
+    closedir(dir);
+fail_exit:
+    return -1;
+}
+
+void image_dir_index_free(image_dir_t* image_dir) {
+    if (image_dir->entries == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < image_dir->entry_count; i++) {
+        free(image_dir->entries[i].name);
+    }
+    free(image_dir->entries);
+
+    image_dir->entries     = NULL;
+    image_dir->entry_count = 0;
 }
@@ -5,10 +5,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "image.h"
 #include "log.h"
+#include "perf.h"
 #include "pipeline.h"
+#include "topology.h"
 
 static void show_help(FILE* f, const char* exec_name) {
     fprintf(f, "Usage: %s [OPTION]...\n", exec_name);
@@ -18,6 +21,10 @@ static void show_help(FILE* f, const char* exec_name) {
     fprintf(f, "  --out PATH                      path to write images\n");
     fprintf(f, "  --quiet                         don't print anything\n");
     fprintf(f, "  --pipeline [serial|pthread|tbb] pipeline algorithm to use\n");
+    fprintf(f, "  --order [name|size]             image loading order (default: name)\n");
+    fprintf(f, "  --numa                          pin pthread workers and their images to NUMA nodes\n");
+    fprintf(f, "  --hugepages                     allocate image pixels on 2 MB pages\n");
+    fprintf(f, "  --perf                          report time and hardware counters of the run and its stages\n");
 }
 
 static void fail_missing_argument(const char* exec_name, const char* opt) {
@@ -38,17 +45,28 @@ static void fail_unknown_pipeline_algorithm(const char* exec_name, const char* a
     exit(1);
 }
 
+static void fail_unknown_order(const char* exec_name, const char* arg) {
+    fprintf(stderr, "%s: unrecognized argument '%s' for option `--order`\n", exec_name, arg);
+    fprintf(stderr, "Try '%s --help' for more information.\n", exec_name);
+    exit(1);
+}
+
 static void fail_multiple_pipeline(const char* exec_name) {
     fprintf(stderr, "%s: zero or one option `--pipeline` must be specified\n", exec_name);
     fprintf(stderr, "Try '%s --help' for more information.\n", exec_name);
     exit(1);
 }
 
-static image_dir_t image_dir = {.load_current = 0, .stop = false};
+static image_dir_t image_dir = {.load_current = 0, .stop = false, .cancel = false};
 
 static void sigint_handler(int sig) {
-    printf("\n\rSIGINT received, stopping pipeline\n");
-    image_dir.stop = true;
+    if (!image_dir.stop) {
+        printf("\n\rSIGINT received, stopping pipeline\n");
+        image_dir.stop = true;
+    } else {
+        printf("\n\rSIGINT received again, cancelling in-flight images\n");
+        image_dir.cancel = true;
+    }
 }
 
 __attribute__((weak)) int pipeline_serial(image_dir_t* image_dir) {
@@ -72,6 +90,7 @@ int main(int argc, char* argv[]) {
     char* input_dir_name;
     char* output_dir_name;
     bool quiet = false;
+    image_dir_order_t order = IMAGE_DIR_ORDER_NAME;
 
     output_dir_name = NULL;
 
@@ -108,6 +127,26 @@ int main(int argc, char* argv[]) {
             }
 
             i++;
+        } else if (strcmp("--order", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            if (strcmp("name", argv[i + 1]) == 0) {
+                order = IMAGE_DIR_ORDER_NAME;
+            } else if (strcmp("size", argv[i + 1]) == 0) {
+                order = IMAGE_DIR_ORDER_SIZE;
+            } else {
+                fail_unknown_order(exec_name, argv[i + 1]);
+            }
+
+            i++;
+        } else if (strcmp("--numa", argv[i]) == 0) {
+            topology_pinning = true;
+        } else if (strcmp("--hugepages", argv[i]) == 0) {
+            image_alloc_mode = IMAGE_ALLOC_HUGE_PAGES;
+        } else if (strcmp("--perf", argv[i]) == 0) {
+            perf_enabled = true;
         } else if (strcmp("--quiet", argv[i]) == 0) {
             quiet = true;
         } else if (strcmp("--help", argv[i]) == 0) {
@@ -140,22 +179,63 @@ int main(int argc, char* argv[]) {
         output_dir_name = input_dir_name;
     }
 
-    printf("Starting image pipeline, press CTRL+C to stop loading images\n");
+    printf("Starting image pipeline, press CTRL+C to stop loading images (twice to cancel)\n");
 
-    int ret;
+    const char* save_prefix;
     if (use_pipeline_serial) {
-        image_dir_reset(&image_dir, input_dir_name, output_dir_name, "serial");
-        pipeline_serial(&image_dir);
+        save_prefix = "serial";
     } else if (use_pipeline_pthread) {
-        image_dir_reset(&image_dir, input_dir_name, output_dir_name, "pthread");
-        pipeline_pthread(&image_dir);
+        save_prefix = "pthread";
     } else if (use_pipeline_tbb) {
-        image_dir_reset(&image_dir, input_dir_name, output_dir_name, "tbb");
-        pipeline_tbb(&image_dir);
+        save_prefix = "tbb";
     } else {
         LOG_ERROR("no pipeline configured");
         exit(1);
     }
 
+    image_dir_reset(&image_dir, input_dir_name, output_dir_name, save_prefix);
+
+    if (image_dir_index(&image_dir, order) < 0) {
+        LOG_ERROR("failed to index directory `%s`", input_dir_name);
+        exit(1);
+    }
+
+    /* opened before the pipeline creates its threads so that they inherit the counters */
+    perf_counters_t counters;
+    perf_values_t start_values;
+    if (perf_enabled) {
+        perf_counters_open(&counters, true);
+        perf_counters_read(&counters, &start_values);
+    }
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    int ret;
+    if (use_pipeline_serial) {
+        ret = pipeline_serial(&image_dir);
+    } else if (use_pipeline_pthread) {
+        ret = pipeline_pthread(&image_dir);
+    } else {
+        ret = pipeline_tbb(&image_dir);
+    }
+
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+    if (perf_enabled) {
+        perf_values_t values;
+        perf_counters_read(&counters, &values);
+        perf_values_diff(&start_values, &values, &values);
+        perf_counters_close(&counters);
+
+        unsigned long long elapsed_us =
+            (end_time.tv_sec - start_time.tv_sec) * 1000000ULL + (end_time.tv_nsec - start_time.tv_nsec) / 1000;
+        perf_report(stdout, save_prefix, elapsed_us, &values);
+    }
+
+    image_dir_index_free(&image_dir);
+    image_pool_release();
+
     return (ret < 0) ? 1 : 0;
 }
@@ -0,0 +1,210 @@
+#include <stdint.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "perf.h"
+
+static const char* PERF_COUNTER_NAMES[PERF_COUNTER_MAX] = {
+    [PERF_COUNTER_CYCLES]       = "cycles",
+    [PERF_COUNTER_INSTRUCTIONS] = "instructions",
+    [PERF_COUNTER_LLC_MISSES]   = "llc_misses",
+    [PERF_COUNTER_DTLB_MISSES]  = "dtlb_misses",
+};
+
+bool perf_enabled = false;
+
+#define PERF_STAGE(stage_name) {.name = stage_name, .mutex = PTHREAD_MUTEX_INITIALIZER}
+
+perf_stage_t perf_stages[PERF_STAGE_MAX] = {
+    [PERF_STAGE_LOAD]    = PERF_STAGE("load"),
+    [PERF_STAGE_SCALE]   = PERF_STAGE("scale"),
+    [PERF_STAGE_SHARPEN] = PERF_STAGE("sharpen"),
+    [PERF_STAGE_SOBEL]   = PERF_STAGE("sobel"),
+    [PERF_STAGE_SAVE]    = PERF_STAGE("save"),
+};
+
+#ifdef __linux__
+static const struct perf_event_attr PERF_COUNTER_ATTRS[PERF_COUNTER_MAX] = {
+    [PERF_COUNTER_CYCLES] =
+        {
+            .type   = PERF_TYPE_HARDWARE,
+            .config = PERF_COUNT_HW_CPU_CYCLES,
+        },
+    [PERF_COUNTER_INSTRUCTIONS] =
+        {
+            .type   = PERF_TYPE_HARDWARE,
+            .config = PERF_COUNT_HW_INSTRUCTIONS,
+        },
+    /* the generic cache miss event maps to last level cache misses on most CPUs */
+    [PERF_COUNTER_LLC_MISSES] =
+        {
+            .type   = PERF_TYPE_HARDWARE,
+            .config = PERF_COUNT_HW_CACHE_MISSES,
+        },
+    [PERF_COUNTER_DTLB_MISSES] =
+        {
+            .type   = PERF_TYPE_HW_CACHE,
+            .config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        },
+};
+
+static int perf_event_open(struct perf_event_attr* attr, bool inherit) {
+    attr->size           = sizeof(*attr);
+    attr->read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr->inherit        = inherit;
+    attr->exclude_kernel = 1;
+    attr->exclude_hv     = 1;
+
+    return syscall(SYS_perf_event_open, attr, 0, -1, -1, 0);
+}
+#endif
+
+void perf_counters_open(perf_counters_t* counters, bool inherit) {
+    for (int i = 0; i < PERF_COUNTER_MAX; i++) {
+        counters->fds[i] = -1;
+
+#ifdef __linux__
+        /* missing hardware, perf_event_paranoid or a container denying the syscall all end up here */
+        struct perf_event_attr attr = PERF_COUNTER_ATTRS[i];
+        counters->fds[i]            = perf_event_open(&attr, inherit);
+#endif
+    }
+}
+
+void perf_counters_close(perf_counters_t* counters) {
+    for (int i = 0; i < PERF_COUNTER_MAX; i++) {
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+            counters->fds[i] = -1;
+        }
+    }
+}
+
+void perf_counters_read(perf_counters_t* counters, perf_values_t* values) {
+    for (int i = 0; i < PERF_COUNTER_MAX; i++) {
+        values->valid[i]  = false;
+        values->counts[i] = 0;
+
+        if (counters->fds[i] < 0) {
+            continue;
+        }
+
+        /* value, time enabled and time running, in the order of the read format */
+        uint64_t sample[3];
+        if (read(counters->fds[i], sample, sizeof(sample)) != sizeof(sample) || sample[2] == 0) {
+            continue;
+        }
+
+        values->valid[i]  = true;
+        values->counts[i] = sample[0];
+
+        /* multiplexed, the counter only ran for part of the time it was enabled */
+        if (sample[2] < sample[1]) {
+            values->counts[i] = (unsigned long long)((long double)sample[0] * sample[1] / sample[2]);
+        }
+    }
+}
+
+void perf_values_diff(perf_values_t* start, perf_values_t* end, perf_values_t* delta) {
+    for (int i = 0; i < PERF_COUNTER_MAX; i++) {
+        delta->valid[i]  = start->valid[i] && end->valid[i];
+        delta->counts[i] = delta->valid[i] ? end->counts[i] - start->counts[i] : 0;
+    }
+}
+
+static uint64_t timespec_diff_us(struct timespec* t1, struct timespec* t2) {
+    uint64_t t1_us = (t1->tv_sec * 1e6) + (t1->tv_nsec / 1e3);
+    uint64_t t2_us = (t2->tv_sec * 1e6) + (t2->tv_nsec / 1e3);
+
+    return (t1_us > t2_us) ? (t1_us - t2_us) : (t2_us - t1_us);
+}
+
+void perf_probe_open(perf_probe_t* probe) {
+    if (!perf_enabled) {
+        return;
+    }
+
+    perf_counters_open(&probe->counters, false);
+}
+
+void perf_probe_close(perf_probe_t* probe) {
+    if (!perf_enabled) {
+        return;
+    }
+
+    perf_counters_close(&probe->counters);
+}
+
+void perf_probe_begin(perf_probe_t* probe) {
+    if (!perf_enabled) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &probe->start_time);
+    perf_counters_read(&probe->counters, &probe->start_values);
+}
+
+void perf_probe_end(perf_probe_t* probe, perf_stage_kind_t stage_kind) {
+    if (!perf_enabled) {
+        return;
+    }
+
+    perf_values_t values;
+    perf_counters_read(&probe->counters, &values);
+    perf_values_diff(&probe->start_values, &values, &values);
+
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+    perf_stage_t* stage = &perf_stages[stage_kind];
+    pthread_mutex_lock(&stage->mutex);
+
+    /* a counter stays valid only if every sample of the stage had it */
+    for (int i = 0; i < PERF_COUNTER_MAX; i++) {
+        stage->values.valid[i] = (stage->images == 0 || stage->values.valid[i]) && values.valid[i];
+        stage->values.counts[i] += values.counts[i];
+    }
+
+    stage->time_us += timespec_diff_us(&probe->start_time, &end_time);
+    stage->images++;
+
+    pthread_mutex_unlock(&stage->mutex);
+}
+
+static void perf_report_row(FILE* file, const char* pipeline, const char* stage, size_t images,
+                            unsigned long long time_us, perf_values_t* values) {
+    fprintf(file, "%s,%s,%zu,%llu", pipeline, stage, images, time_us);
+
+    for (int i = 0; i < PERF_COUNTER_MAX; i++) {
+        if (values->valid[i]) {
+            fprintf(file, ",%llu", values->counts[i]);
+        } else {
+            fprintf(file, ",");
+        }
+    }
+
+    fprintf(file, "\n");
+}
+
+void perf_report(FILE* file, const char* pipeline, unsigned long long time_us, perf_values_t* values) {
+    fprintf(file, "pipeline,stage,images,time_us");
+    for (int i = 0; i < PERF_COUNTER_MAX; i++) {
+        fprintf(file, ",%s", PERF_COUNTER_NAMES[i]);
+    }
+    fprintf(file, "\n");
+
+    perf_report_row(file, pipeline, "total", perf_stages[PERF_STAGE_SAVE].images, time_us, values);
+
+    /* stage time is the sum over threads, it can exceed the wall time of the run */
+    for (int i = 0; i < PERF_STAGE_MAX; i++) {
+        perf_stage_t* stage = &perf_stages[i];
+        if (stage->images > 0) {
+            perf_report_row(file, pipeline, stage->name, stage->images, stage->time_us, &stage->values);
+        }
+    }
+}
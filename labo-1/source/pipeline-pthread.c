@@ -1,17 +1,30 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "filter.h"
+#include "log.h"
+#include "perf.h"
 #include "pipeline.h"
 #include "queue.h"
+#include "topology.h"
 
 typedef struct io_image {
 	image_dir_t* image_dir;
 	queue_t* queue;
 } io_image_t;
 
+typedef struct load_image {
+	image_dir_t* image_dir;
+	queue_t* queue;
+	int* loaders_active; // Loaders still reading the manifest, the last one closes the queue
+} load_image_t;
+
 typedef struct queues {
+	image_dir_t* image_dir;
 	queue_t* queue1;
 	queue_t* queue2;
+	int* workers_active; // Workers still popping queue1, the last one closes queue2
 } queues_t;
 
 void* load_images(void* load_image_void);
@@ -20,145 +33,204 @@ void* sharpen_images(void* queues_void);
 void* sobel_images(void* queues_void);
 void* save_images(void* save_image_void);
 
+// One copy of the pipeline per NUMA node, so an image stays on the node that loaded it
+typedef struct lane {
+	queue_t* queues[4];
+	int loaders_active;
+	int workers_active[3];
+	load_image_t load_image;
+	queues_t stage_queues[3];
+	io_image_t save_image;
+	pthread_attr_t attr;
+	pthread_t* threads;
+	int thread_count;
+} lane_t;
+
+static void report_numastat(topology_t* topology, topology_numastat_t* before) {
+	for (size_t i = 0; i < topology->node_count; i++) {
+		/* a node whose counters could not be read before the run has nothing to compare with */
+		topology_numastat_t after;
+		if (!before[i].available || topology_numastat(&topology->nodes[i], &after) < 0) {
+			continue;
+		}
+		printf("node %u: %llu local / %llu remote page allocations (system-wide)\n", topology->nodes[i].id,
+		       after.local - before[i].local, after.remote - before[i].remote);
+	}
+}
+
 int pipeline_pthread(image_dir_t* image_dir) {
 	const int num_threads[4] = {12, 12, 12, 12}; // Number of threads to create
-	queue_t* queue1 = queue_create(num_threads[0] * sizeof(image_t*));
-	queue_t* queue2 = queue_create(num_threads[1] * sizeof(image_t*));
-	queue_t* queue3 = queue_create(num_threads[2] * sizeof(image_t*));
-	queue_t* queue4 = queue_create(num_threads[3] * sizeof(image_t*));
-
-	pthread_t thread0;
-	pthread_t threads1[num_threads[0]];
-	pthread_t threads2[num_threads[1]];
-	pthread_t threads3[num_threads[2]];
-	pthread_t threads4[num_threads[3]];
-
-	io_image_t load_image = {image_dir, queue1};
-	io_image_t save_image = {image_dir, queue4};
-	queues_t queues1 = {queue1, queue2};
-	queues_t queues2 = {queue2, queue3};
-	queues_t queues3 = {queue3, queue4};
-
-	pthread_create(&thread0, NULL, load_images, (void*) &load_image);
-
-	for(int i = 0; i < num_threads[0]; i++) {
-		pthread_create(&threads1[i], NULL, scale_images, (void*) &queues1);
-	}
+	// The manifest cursor is atomic, so several threads can decode PNGs at once
+	const int num_loaders = (image_dir->entries != NULL) ? 4 : 1;
+	void* (*stages[3])(void*) = {scale_images, sharpen_images, sobel_images};
 
-	for(int i = 0; i < num_threads[1]; i++) {
-		pthread_create(&threads2[i], NULL, sharpen_images, (void*) &queues2);
+	topology_t topology;
+	if (topology_discover(&topology) < 0) {
+		return -1;
 	}
 
-	for(int i = 0; i < num_threads[2]; i++) {
-		pthread_create(&threads3[i], NULL, sobel_images, (void*) &queues3);
+	const int num_lanes = (topology_pinning && image_dir->entries != NULL) ? topology.node_count : 1;
+	const int lane_loaders = (num_loaders / num_lanes > 0) ? num_loaders / num_lanes : 1;
+	int lane_threads[4];
+	for (int s = 0; s < 4; s++) {
+		lane_threads[s] = (num_threads[s] / num_lanes > 0) ? num_threads[s] / num_lanes : 1;
 	}
-	
-	for(int i = 0; i < num_threads[3]; i++) {
-		pthread_create(&threads4[i], NULL, save_images, (void*) &save_image);
+
+	topology_numastat_t numastat[topology.node_count];
+	memset(numastat, 0, sizeof(numastat));
+	if (topology_pinning) {
+		topology_enable_first_touch();
+		for (size_t i = 0; i < topology.node_count; i++) {
+			topology_numastat(&topology.nodes[i], &numastat[i]);
+		}
 	}
 
-	pthread_join(thread0, NULL);
+	lane_t lanes[num_lanes];
+	for (int l = 0; l < num_lanes; l++) {
+		lane_t* lane = &lanes[l];
 
-	for(int i = 0; i < num_threads[0]; i++) {
-		pthread_join(threads1[i], NULL);
-	}
+		for (int s = 0; s < 4; s++) {
+			lane->queues[s] = queue_create(lane_threads[s] * sizeof(image_t*));
+		}
+
+		lane->loaders_active = lane_loaders;
+		lane->load_image = (load_image_t) {image_dir, lane->queues[0], &lane->loaders_active};
+		lane->save_image = (io_image_t) {image_dir, lane->queues[3]};
+		for (int s = 0; s < 3; s++) {
+			lane->workers_active[s] = lane_threads[s];
+			lane->stage_queues[s] = (queues_t) {image_dir, lane->queues[s], lane->queues[s + 1],
+			                                    &lane->workers_active[s]};
+		}
+
+		bool pinned = false;
+		if (topology_pinning) {
+			pinned = topology_attr_init(&lane->attr, &topology.nodes[l % topology.node_count]) == 0;
+			if (!pinned) {
+				// topology_attr_init destroyed the attributes on failure, the lane runs unpinned
+				LOG_ERROR("failed to pin lane %d to its NUMA node, its threads are not pinned", l);
+			}
+		}
+
+		if (!pinned) {
+			pthread_attr_init(&lane->attr);
+		}
+
+		lane->threads = malloc((lane_loaders + lane_threads[0] + lane_threads[1] + lane_threads[2] + lane_threads[3])
+		                       * sizeof(pthread_t));
+		lane->thread_count = 0;
+
+		for(int i = 0; i < lane_loaders; i++) {
+			pthread_create(&lane->threads[lane->thread_count++], &lane->attr, load_images, (void*) &lane->load_image);
+		}
+
+		for (int s = 0; s < 3; s++) {
+			for(int i = 0; i < lane_threads[s]; i++) {
+				pthread_create(&lane->threads[lane->thread_count++], &lane->attr, stages[s],
+				               (void*) &lane->stage_queues[s]);
+			}
+		}
 
-	for(int i = 0; i < num_threads[1]; i++) {
-		pthread_join(threads2[i], NULL);
+		for(int i = 0; i < lane_threads[3]; i++) {
+			pthread_create(&lane->threads[lane->thread_count++], &lane->attr, save_images, (void*) &lane->save_image);
+		}
 	}
 
-	for(int i = 0; i < num_threads[2]; i++) {
-		pthread_join(threads3[i], NULL);
+	for (int l = 0; l < num_lanes; l++) {
+		for(int i = 0; i < lanes[l].thread_count; i++) {
+			pthread_join(lanes[l].threads[i], NULL);
+		}
+
+		free(lanes[l].threads);
+		pthread_attr_destroy(&lanes[l].attr);
+		for (int s = 0; s < 4; s++) {
+			queue_destroy(lanes[l].queues[s]);
+		}
 	}
 
-	for(int i = 0; i < num_threads[3]; i++) {
-		pthread_join(threads4[i], NULL);
+	printf("\n");
+	if (topology_pinning) {
+		report_numastat(&topology, numastat);
 	}
 
-	queue_destroy(queue1);
-	queue_destroy(queue2);
-	queue_destroy(queue3);
-	queue_destroy(queue4);
+	topology_release(&topology);
 
 	return 0;
 }
 
 
+static bool is_cancelled(image_dir_t* image_dir) {
+	bool cancel;
+	__atomic_load(&image_dir->cancel, &cancel, __ATOMIC_RELAXED);
+	return cancel;
+}
+
 void* load_images(void* load_image_void) {
-	io_image_t* load_image = (io_image_t*) load_image_void;
+	load_image_t* load_image = (load_image_t*) load_image_void;
 	image_dir_t* image_dir = load_image->image_dir;
 	queue_t* queue = load_image->queue;
 	image_t* image;
+	perf_probe_t probe;
+	perf_probe_open(&probe);
 	while (1) {
+		perf_probe_begin(&probe);
 		image = image_dir_load_next(image_dir);
-		queue_push(queue, image);
 		if (image == NULL) {
-			for (int i = 0; i < 12; i++) {
-				queue_push(queue, image);
-			}
 			break;
 		}
+		perf_probe_end(&probe, PERF_STAGE_LOAD);
+		if (queue_push(queue, image) < 0) {
+			image_destroy(image);
+		}
+	}
+	perf_probe_close(&probe);
+	// Only the last loader to finish ends the stream
+	if (__atomic_sub_fetch(load_image->loaders_active, 1, __ATOMIC_ACQ_REL) == 0) {
+		queue_close(queue);
 	}
 	return NULL;
 }
 
-void* scale_images(void* queues_void) {
-	queues_t* queues = (queues_t*) queues_void;
-	queue_t* queue1 = queues->queue1;
-	queue_t* queue2 = queues->queue2;
-
+// Pops until queue1 is closed and drained; once cancelled, images are dropped instead of filtered
+static void run_stage(queues_t* queues, image_t* (*filter)(image_t*), perf_stage_kind_t stage) {
 	image_t* image;
 	image_t* new_image;
-	while (1) {
-		image = queue_pop(queue1);
-		if (image == NULL) {
-			queue_push(queue2, image);
-			break;
+	perf_probe_t probe;
+	perf_probe_open(&probe);
+	while (queue_pop_value(queues->queue1, (void**) &image) == 0) {
+		if (is_cancelled(queues->image_dir)) {
+			image_destroy(image);
+			continue;
 		}
-		new_image = filter_scale_up(image, 2);
-		queue_push(queue2, new_image);
+		perf_probe_begin(&probe);
+		new_image = filter(image);
 		image_destroy(image);
+		perf_probe_end(&probe, stage);
+		if (new_image != NULL && queue_push(queues->queue2, new_image) < 0) {
+			image_destroy(new_image);
+		}
+	}
+	perf_probe_close(&probe);
+	if (__atomic_sub_fetch(queues->workers_active, 1, __ATOMIC_ACQ_REL) == 0) {
+		queue_close(queues->queue2);
 	}
+}
+
+static image_t* filter_scale_up_2(image_t* image) {
+	return filter_scale_up(image, 2);
+}
+
+void* scale_images(void* queues_void) {
+	run_stage((queues_t*) queues_void, filter_scale_up_2, PERF_STAGE_SCALE);
 	return NULL;
 }
 
 void* sharpen_images(void* queues_void) {
-	queues_t* queues = (queues_t*) queues_void;
-	queue_t* queue1 = queues->queue1;
-	queue_t* queue2 = queues->queue2;
-
-	image_t* image;
-	image_t* new_image;
-	while (1) {
-		image = queue_pop(queue1);
-		if (image == NULL) {
-			queue_push(queue2, image);
-			break;
-		}
-		new_image = filter_sharpen(image);
-		queue_push(queue2, new_image);
-		image_destroy(image);
-	}
+	run_stage((queues_t*) queues_void, filter_sharpen, PERF_STAGE_SHARPEN);
 	return NULL;
 }
 
 void* sobel_images(void* queues_void) {
-	queues_t* queues = (queues_t*) queues_void;
-	queue_t* queue1 = queues->queue1;
-	queue_t* queue2 = queues->queue2;
-
-	image_t* image;
-	image_t* new_image;
-	while (1) {
-		image = queue_pop(queue1);
-		if (image == NULL) {
-			queue_push(queue2, image);
-			break;
-		}
-		new_image = filter_sobel(image);
-		queue_push(queue2, new_image);
-		image_destroy(image);
-	}
+	run_stage((queues_t*) queues_void, filter_sobel, PERF_STAGE_SOBEL);
 	return NULL;
 }
 
@@ -167,16 +239,19 @@ void* save_images(void* save_image_void) {
 	image_dir_t* image_dir = save_image->image_dir;
 	queue_t* queue = save_image->queue;
 	image_t* image;
-	
-	while (1) {
-		image = queue_pop(queue);
-		if (image == NULL) {
-			break;
+	perf_probe_t probe;
+	perf_probe_open(&probe);
+
+	while (queue_pop_value(queue, (void**) &image) == 0) {
+		if (!is_cancelled(image_dir)) {
+			perf_probe_begin(&probe);
+			image_dir_save(image_dir, image);
+			printf(".");
+			fflush(stdout);
+			perf_probe_end(&probe, PERF_STAGE_SAVE);
 		}
-		image_dir_save(image_dir, image);
-		printf(".");
-        fflush(stdout);
-        image_destroy(image);
+		image_destroy(image);
 	}
+	perf_probe_close(&probe);
 	return NULL;
-}
\ No newline at end of file
+}
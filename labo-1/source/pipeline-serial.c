@@ -3,42 +3,58 @@
 #include <stdio.h>
 
 #include "filter.h"
+#include "perf.h"
 #include "pipeline.h"
 
 int pipeline_serial(image_dir_t* image_dir) {
-    while (1) {
+    perf_probe_t probe;
+    perf_probe_open(&probe);
+
+    while (!image_dir->cancel) {
+        perf_probe_begin(&probe);
         image_t* image1 = image_dir_load_next(image_dir);
         if (image1 == NULL) {
             break;
         }
+        perf_probe_end(&probe, PERF_STAGE_LOAD);
 
+        perf_probe_begin(&probe);
         image_t* image2 = filter_scale_up(image1, 2);
         image_destroy(image1);
         if (image2 == NULL) {
             goto fail_exit;
         }
+        perf_probe_end(&probe, PERF_STAGE_SCALE);
 
+        perf_probe_begin(&probe);
         image_t* image3 = filter_sharpen(image2);
         image_destroy(image2);
         if (image3 == NULL) {
             goto fail_exit;
         }
+        perf_probe_end(&probe, PERF_STAGE_SHARPEN);
 
+        perf_probe_begin(&probe);
         image_t* image4 = filter_sobel(image3);
         image_destroy(image3);
         if (image4 == NULL) {
             goto fail_exit;
         }
+        perf_probe_end(&probe, PERF_STAGE_SOBEL);
 
+        perf_probe_begin(&probe);
         image_dir_save(image_dir, image4);
         printf(".");
         fflush(stdout);
         image_destroy(image4);
+        perf_probe_end(&probe, PERF_STAGE_SAVE);
     }
 
     printf("\n");
+    perf_probe_close(&probe);
     return 0;
 
 fail_exit:
+    perf_probe_close(&probe);
     return -1;
 }
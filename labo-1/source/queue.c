@@ -13,8 +13,9 @@ queue_t* queue_create(size_t size) {
         goto fail_exit;
     }
 
-    queue->size = size;
-    queue->used = 0;
+    queue->size   = size;
+    queue->used   = 0;
+    queue->closed = false;
 
     errno = pthread_mutex_init(&queue->mutex, NULL);
     if (errno != 0) {
@@ -73,7 +74,7 @@ int queue_push(queue_t* queue, void* ptr) {
         goto fail_free_node;
     }
 
-    while (queue->used == queue->size) {
+    while (queue->used == queue->size && !queue->closed) {
         errno = pthread_cond_wait(&queue->modified_item_poped, &queue->mutex);
         if (errno != 0) {
             LOG_ERROR_ERRNO("pthread_cond_wait");
@@ -81,6 +82,10 @@ int queue_push(queue_t* queue, void* ptr) {
         }
     }
 
+    if (queue->closed) {
+        goto fail_unlock_mutex;
+    }
+
     node->value = ptr;
     node->prev  = NULL;
 
@@ -116,14 +121,14 @@ fail_exit:
     return -1;
 }
 
-void* queue_pop(queue_t* queue) {
+int queue_pop_value(queue_t* queue, void** value) {
     errno = pthread_mutex_lock(&queue->mutex);
     if (errno != 0) {
         LOG_ERROR_ERRNO("pthread_mutex_lock");
         goto fail_exit;
     }
 
-    while (queue->used == 0) {
+    while (queue->used == 0 && !queue->closed) {
         errno = pthread_cond_wait(&queue->modified_item_pushed, &queue->mutex);
         if (errno != 0) {
             LOG_ERROR_ERRNO("pthread_cond_wait");
@@ -131,10 +136,14 @@ void* queue_pop(queue_t* queue) {
         }
     }
 
+    if (queue->used == 0) {
+        goto closed_unlock_mutex;
+    }
+
     queue_node_t* head = queue->head;
     queue->head        = head->prev;
 
-    void* value = head->value;
+    *value = head->value;
     free(head);
 
     if (--queue->used == 0) {
@@ -154,10 +163,37 @@ void* queue_pop(queue_t* queue) {
         goto fail_exit;
     }
 
-    return value;
+    return 0;
+
+closed_unlock_mutex:
+    pthread_mutex_unlock(&queue->mutex);
+    *value = NULL;
+    return QUEUE_CLOSED;
 
 fail_unlock_mutex:
     pthread_mutex_unlock(&queue->mutex);
 fail_exit:
-    return NULL;
+    *value = NULL;
+    return -1;
+}
+
+void* queue_pop(queue_t* queue) {
+    void* value;
+    queue_pop_value(queue, &value);
+    return value;
+}
+
+void queue_close(queue_t* queue) {
+    errno = pthread_mutex_lock(&queue->mutex);
+    if (errno != 0) {
+        LOG_ERROR_ERRNO("pthread_mutex_lock");
+        return;
+    }
+
+    queue->closed = true;
+
+    pthread_cond_broadcast(&queue->modified_item_pushed);
+    pthread_cond_broadcast(&queue->modified_item_poped);
+
+    pthread_mutex_unlock(&queue->mutex);
 }
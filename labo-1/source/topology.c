@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "image.h"
+#include "log.h"
+#include "topology.h"
+
+static const char* TOPOLOGY_NODE_DIR = "/sys/devices/system/node";
+
+bool topology_pinning = false;
+
+static int append_cpu(topology_node_t* node, int cpu) {
+    int* cpus = realloc(node->cpus, (node->cpu_count + 1) * sizeof(*cpus));
+    if (cpus == NULL) {
+        LOG_ERROR_ERRNO("realloc");
+        return -1;
+    }
+
+    node->cpus                    = cpus;
+    node->cpus[node->cpu_count++] = cpu;
+    return 0;
+}
+
+/* parses a kernel cpulist such as `0-3,8-11` */
+static int parse_cpulist(topology_node_t* node, const char* cpulist) {
+    const char* cursor = cpulist;
+
+    while (*cursor != '\0' && *cursor != '\n') {
+        char* end;
+        long first = strtol(cursor, &end, 10);
+        long last  = first;
+
+        if (end == cursor) {
+            LOG_ERROR("invalid cpulist `%s`", cpulist);
+            return -1;
+        }
+
+        if (*end == '-') {
+            cursor = end + 1;
+            last   = strtol(cursor, &end, 10);
+        }
+
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (append_cpu(node, cpu) < 0) {
+                return -1;
+            }
+        }
+
+        cursor = (*end == ',') ? end + 1 : end;
+    }
+
+    return 0;
+}
+
+static int read_node_cpus(topology_node_t* node) {
+    const size_t buffer_size = 256;
+    char buffer[buffer_size];
+
+    snprintf(buffer, buffer_size, "%s/node%u/cpulist", TOPOLOGY_NODE_DIR, node->id);
+
+    FILE* file = fopen(buffer, "r");
+    if (file == NULL) {
+        LOG_ERROR_ERRNO("fopen");
+        goto fail_exit;
+    }
+
+    char cpulist[1024];
+    if (fgets(cpulist, sizeof(cpulist), file) == NULL) {
+        LOG_ERROR("failed to read `%s`", buffer);
+        goto fail_close_file;
+    }
+
+    if (parse_cpulist(node, cpulist) < 0) {
+        goto fail_close_file;
+    }
+
+    fclose(file);
+    return 0;
+
+fail_close_file:
+    fclose(file);
+fail_exit:
+    return -1;
+}
+
+static int discover_fallback(topology_t* topology) {
+    topology->nodes = calloc(1, sizeof(*topology->nodes));
+    if (topology->nodes == NULL) {
+        LOG_ERROR_ERRNO("calloc");
+        return -1;
+    }
+
+    topology->node_count = 1;
+
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < cpu_count; cpu++) {
+        if (append_cpu(&topology->nodes[0], cpu) < 0) {
+            topology_release(topology);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int topology_discover(topology_t* topology) {
+    topology->nodes      = NULL;
+    topology->node_count = 0;
+
+    DIR* dir = opendir(TOPOLOGY_NODE_DIR);
+    if (dir == NULL) {
+        return discover_fallback(topology);
+    }
+
+    struct dirent* dirent;
+    while ((dirent = readdir(dir)) != NULL) {
+        unsigned int id;
+        char tail;
+
+        /* `node12` but not `node12x` nor `possible` */
+        if (sscanf(dirent->d_name, "node%u%c", &id, &tail) != 1) {
+            continue;
+        }
+
+        topology_node_t* nodes = realloc(topology->nodes, (topology->node_count + 1) * sizeof(*nodes));
+        if (nodes == NULL) {
+            LOG_ERROR_ERRNO("realloc");
+            goto fail_release;
+        }
+
+        topology->nodes       = nodes;
+        topology_node_t* node = &topology->nodes[topology->node_count++];
+        node->id              = id;
+        node->cpus            = NULL;
+        node->cpu_count       = 0;
+
+        if (read_node_cpus(node) < 0) {
+            goto fail_release;
+        }
+
+        /* memory-only nodes cannot run workers */
+        if (node->cpu_count == 0) {
+            topology->node_count--;
+        }
+    }
+
+    closedir(dir);
+
+    if (topology->node_count == 0) {
+        topology_release(topology);
+        return discover_fallback(topology);
+    }
+
+    return 0;
+
+fail_release:
+    closedir(dir);
+    topology_release(topology);
+    return -1;
+}
+
+void topology_release(topology_t* topology) {
+    for (size_t i = 0; i < topology->node_count; i++) {
+        free(topology->nodes[i].cpus);
+    }
+    free(topology->nodes);
+
+    topology->nodes      = NULL;
+    topology->node_count = 0;
+}
+
+int topology_attr_init(pthread_attr_t* attr, topology_node_t* node) {
+    errno = pthread_attr_init(attr);
+    if (errno != 0) {
+        LOG_ERROR_ERRNO("pthread_attr_init");
+        goto fail_exit;
+    }
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (size_t i = 0; i < node->cpu_count; i++) {
+        CPU_SET(node->cpus[i], &set);
+    }
+
+    errno = pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+    if (errno != 0) {
+        LOG_ERROR_ERRNO("pthread_attr_setaffinity_np");
+        goto fail_destroy_attr;
+    }
+#endif
+
+    return 0;
+
+#ifdef __linux__
+fail_destroy_attr:
+    pthread_attr_destroy(attr);
+#endif
+fail_exit:
+    return -1;
+}
+
+void topology_enable_first_touch(void) {
+    image_first_touch = true;
+
+#ifdef __GLIBC__
+    /*
+     * A fixed threshold keeps image buffers on fresh mmap pages instead of
+     * recycled heap chunks that were faulted in by a thread on another node.
+     */
+    mallopt(M_MMAP_THRESHOLD, 1024 * 1024);
+#endif
+}
+
+int topology_numastat(topology_node_t* node, topology_numastat_t* numastat) {
+    const size_t buffer_size = 256;
+    char buffer[buffer_size];
+
+    snprintf(buffer, buffer_size, "%s/node%u/numastat", TOPOLOGY_NODE_DIR, node->id);
+
+    numastat->local     = 0;
+    numastat->remote    = 0;
+    numastat->available = false;
+
+    FILE* file = fopen(buffer, "r");
+    if (file == NULL) {
+        goto fail_exit;
+    }
+
+    char name[64];
+    unsigned long long value;
+    while (fscanf(file, "%63s %llu", name, &value) == 2) {
+        if (strcmp(name, "local_node") == 0) {
+            numastat->local = value;
+        } else if (strcmp(name, "other_node") == 0) {
+            numastat->remote = value;
+        }
+    }
+
+    fclose(file);
+    numastat->available = true;
+    return 0;
+
+fail_exit:
+    return -1;
+}
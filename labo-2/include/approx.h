@@ -0,0 +1,83 @@
+#ifndef INCLUDE_APPROX_H_
+#define INCLUDE_APPROX_H_
+
+#include <math.h>
+
+/*
+ * Float polynomial approximations of sin, cos and atan (Cephes minimax
+ * coefficients), used by the simd method and the native precision. The error stays around 1e-7, well inside the tolerance the
+ * checker allows against the double precision libm of the serial version.
+ */
+
+static const float APPROX_TWO_OVER_PI = 0.636619772367581343f;
+
+/*
+ * pi/2 split in three parts so that `x - q * pi/2` stays exact for large q.
+ * Past APPROX_REDUCTION_MAX the float parts lose the argument, small frames
+ * reach phases around 1e6, so libm reduces those.
+ */
+static const float APPROX_REDUCTION_MAX = 8192.0f;
+
+static const float APPROX_PIO2_1 = 1.5703125f;
+static const float APPROX_PIO2_2 = 4.837512969970703125e-4f;
+static const float APPROX_PIO2_3 = 7.54978995489188216e-8f;
+
+static const float APPROX_SIN_1 = -1.6666654611e-1f;
+static const float APPROX_SIN_2 = 8.3321608736e-3f;
+static const float APPROX_SIN_3 = -1.9515295891e-4f;
+
+static const float APPROX_COS_1 = 4.166664568298827e-2f;
+static const float APPROX_COS_2 = -1.388731625493765e-3f;
+static const float APPROX_COS_3 = 2.443315711809948e-5f;
+
+static const float APPROX_TAN_3PI_8 = 2.414213562373095f;
+static const float APPROX_TAN_PI_8  = 0.4142135623730950f;
+
+static const float APPROX_ATAN_1 = 8.05374449538e-2f;
+static const float APPROX_ATAN_2 = -1.38776856032e-1f;
+static const float APPROX_ATAN_3 = 1.99777106478e-1f;
+static const float APPROX_ATAN_4 = -3.33329491539e-1f;
+
+/* sin(x) when `quadrant` is 0, cos(x) when it is 1 */
+static inline float approx_sincosf(float x, int quadrant) {
+    if (fabsf(x) > APPROX_REDUCTION_MAX) {
+        return quadrant ? cosf(x) : sinf(x);
+    }
+
+    float q = nearbyintf(x * APPROX_TWO_OVER_PI);
+    float r = x - q * APPROX_PIO2_1;
+    r       = r - q * APPROX_PIO2_2;
+    r       = r - q * APPROX_PIO2_3;
+
+    int n    = (int)q + quadrant;
+    float r2 = r * r;
+
+    float result;
+    if (n & 1) {
+        result = 1.0f - 0.5f * r2 + r2 * r2 * (APPROX_COS_1 + r2 * (APPROX_COS_2 + r2 * APPROX_COS_3));
+    } else {
+        result = r + r * r2 * (APPROX_SIN_1 + r2 * (APPROX_SIN_2 + r2 * APPROX_SIN_3));
+    }
+
+    return (n & 2) ? -result : result;
+}
+
+static inline float approx_atanf(float x) {
+    float ax = fabsf(x);
+    float y  = 0.0f;
+
+    if (ax > APPROX_TAN_3PI_8) {
+        y  = M_PI_2;
+        ax = -1.0f / ax;
+    } else if (ax > APPROX_TAN_PI_8) {
+        y  = M_PI_4;
+        ax = (ax - 1.0f) / (ax + 1.0f);
+    }
+
+    float z = ax * ax;
+    y += (((APPROX_ATAN_1 * z + APPROX_ATAN_2) * z + APPROX_ATAN_3) * z + APPROX_ATAN_4) * z * ax + ax;
+
+    return copysignf(y, x);
+}
+
+#endif /* INCLUDE_APPROX_H_ */
@@ -3,10 +3,28 @@
 #ifndef INCLUDE_COLOR_H_
 #define INCLUDE_COLOR_H_
 
+#include <math.h>
+
 #include "pixel.h"
 
+/* sinoscope values are in [0, 200], the color only depends on their integer part */
+#define COLOR_PALETTE_SIZE 201
+
 unsigned int color_get_interval(float max);
 float color_get_interval_inverse(float max);
 void color_value(pixel_t* pixel, float value, int interval, float interval_inverse);
+void color_palette(pixel_t* palette, int interval, float interval_inverse);
+
+static inline const pixel_t* color_lookup(const pixel_t* palette, float value) {
+    if (isnan(value)) {
+        return &pixel_black;
+    }
+
+    int index = value;
+    index     = index < 0 ? 0 : index;
+    index     = index >= COLOR_PALETTE_SIZE ? COLOR_PALETTE_SIZE - 1 : index;
+
+    return &palette[index];
+}
 
 #endif /* INCLUDE_COLOR_H_ */
@@ -0,0 +1,52 @@
+#ifndef INCLUDE_FRAME_RING_H_
+#define INCLUDE_FRAME_RING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Triple buffering between one renderer and one consumer. The renderer
+ * owns the back buffer and the consumer the front buffer, the third one
+ * holds the latest finished frame. Neither side ever waits: a frame
+ * published before the previous one was taken is dropped, and a consumer
+ * finding nothing new shows the same frame again.
+ */
+typedef struct frame_ring {
+    unsigned char* buffers[3];
+
+    /* only touched by their own side */
+    unsigned int back;
+    unsigned int front;
+    /* index of the latest frame, flagged as fresh until the consumer takes it */
+    unsigned int ready;
+
+    long dropped;
+    long duplicated;
+} frame_ring_t;
+
+int frame_ring_init(frame_ring_t* ring, size_t size);
+void frame_ring_destroy(frame_ring_t* ring);
+
+/* renderer side, the buffer stays valid until the next publish */
+static inline unsigned char* frame_ring_back(frame_ring_t* ring) {
+    return ring->buffers[ring->back];
+}
+
+/*
+ * renderer side, the async OpenCL handler swaps the buffer it renders into
+ * with one of its own: the ring takes that one as back buffer and the
+ * handler keeps the previous one, both have the size of the ring
+ */
+static inline void frame_ring_adopt_back(frame_ring_t* ring, unsigned char* buffer) {
+    ring->buffers[ring->back] = buffer;
+}
+
+void frame_ring_publish(frame_ring_t* ring);
+
+/* consumer side, `fresh` tells whether the frame differs from the last acquired one */
+const unsigned char* frame_ring_acquire(frame_ring_t* ring, bool* fresh);
+
+/* counters since the previous call, read by the fps loops */
+void frame_ring_counters(frame_ring_t* ring, long* dropped, long* duplicated);
+
+#endif /* INCLUDE_FRAME_RING_H_ */
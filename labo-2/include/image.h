@@ -25,5 +25,8 @@ static inline pixel_t* image_get_pixel(image_t* image, unsigned int x, unsigned
 image_t* image_create(size_t width, size_t height);
 void image_destroy(image_t* image);
 int image_save_png(image_t* image, char* filename);
+/* writes a packed RGB (3 channels) or RGBA (4 channels) buffer without going through an image_t */
+int image_save_png_packed(const unsigned char* buffer, size_t width, size_t height, unsigned int channels,
+                          const char* filename);
 
 #endif /* INCLUDE_IMAGE_H_ */
@@ -0,0 +1,22 @@
+#ifndef INCLUDE_OPENCL_CACHE_H_
+#define INCLUDE_OPENCL_CACHE_H_
+
+#include <stdbool.h>
+
+#include <CL/cl.h>
+
+/* set by `--opencl-cache`, NULL uses $XDG_CACHE_HOME/sinoscope or ~/.cache/sinoscope */
+extern char* opencl_cache_dir;
+/* cleared by `--no-opencl-cache` */
+extern bool opencl_cache_enabled;
+
+/*
+ * Builds `source` for a single device. The binary is saved in the cache
+ * directory and loaded again by later runs with the same device name,
+ * driver version, build options, source and `dependencies`, a NULL
+ * terminated list of the files included by the source.
+ */
+int opencl_cache_build_program(cl_context context, cl_device_id device_id, const char* source, size_t len,
+                               const char* options, const char* const* dependencies, cl_program* program);
+
+#endif /* INCLUDE_OPENCL_CACHE_H_ */
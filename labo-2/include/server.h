@@ -0,0 +1,72 @@
+#ifndef INCLUDE_SERVER_H
+#define INCLUDE_SERVER_H
+
+#include <stdint.h>
+
+#include "sinoscope.h"
+
+/*
+ * Protocol of the frame server, over a SOCK_SEQPACKET unix socket so that
+ * every message is read whole. On connection the server sends a
+ * server_hello_t with the shared memory of its frame ring attached
+ * (SCM_RIGHTS). Clients map it and send server_request_t messages: every
+ * frame request is answered by a server_reply_t naming the ring slot the
+ * frame was rendered into. The slot belongs to the client until it is
+ * released, the server never writes it in the meantime.
+ */
+#define SERVER_PROTOCOL_VERSION 1
+
+typedef struct server_hello {
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    /* 3 for SINOSCOPE_FORMAT_RGB8, 4 for SINOSCOPE_FORMAT_RGBA8 */
+    uint32_t pixel_size;
+    uint32_t slot_count;
+    /* slot `i` starts at `i * slot_size` in the mapping, the frame takes width * height * pixel_size bytes */
+    uint64_t slot_size;
+} server_hello_t;
+
+typedef enum server_request_type {
+    SERVER_REQUEST_FRAME   = 1,
+    SERVER_REQUEST_RELEASE = 2,
+} server_request_type_t;
+
+/* phase0 and phase1 of the request are used instead of being derived from the time */
+#define SERVER_FLAG_PHASES (1u << 0)
+
+typedef struct server_request {
+    /* server_request_type_t */
+    uint32_t type;
+    /* echoed in the reply of a frame request */
+    uint32_t id;
+    uint32_t flags;
+    /* slot given back by a release request */
+    uint32_t slot;
+    float time;
+    float phase0;
+    float phase1;
+} server_request_t;
+
+/* negative slots of a reply */
+#define SERVER_SLOT_BUSY -1
+#define SERVER_SLOT_FAILED -2
+
+typedef struct server_reply {
+    uint32_t id;
+    /* SERVER_SLOT_BUSY while every slot is held, the request can be sent again after a release */
+    int32_t slot;
+    /* animation state the frame was rendered with */
+    float time;
+    float phase0;
+    float phase1;
+} server_reply_t;
+
+/*
+ * Serves frames of `sinoscope` on the socket at `path` until SIGINT or
+ * SIGTERM. The ring holds `slots` frames, the requests received together
+ * are rendered as one batch straight into their slots.
+ */
+int server_run(sinoscope_t* sinoscope, const char* path, unsigned int slots);
+
+#endif /* INCLUDE_SERVER_H */
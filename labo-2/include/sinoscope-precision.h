@@ -0,0 +1,74 @@
+#ifndef INCLUDE_SINOSCOPE_PRECISION_H_
+#define INCLUDE_SINOSCOPE_PRECISION_H_
+
+#include <math.h>
+
+#include "approx.h"
+#include "sinoscope.h"
+
+/*
+ * Value in [0, 200] of the pixel at column `i` of row `j`. The handlers
+ * call it with a constant `precision` from one loop per precision, so that
+ * every loop is compiled with the arithmetic of its precision only.
+ */
+static inline __attribute__((always_inline)) float
+sinoscope_precision_value(const sinoscope_t* sinoscope, int i, int j, sinoscope_precision_t precision) {
+    switch (precision) {
+    case SINOSCOPE_PRECISION_DOUBLE: {
+        double px    = (double)sinoscope->dx * j - 2 * M_PI;
+        double py    = (double)sinoscope->dy * i - 2 * M_PI;
+        double value = 0;
+
+        for (int k = 1; k <= sinoscope->taylor; k += 2) {
+            value += sin(px * k * sinoscope->phase1 + sinoscope->time) / k;
+            value += cos(py * k * sinoscope->phase0) / k;
+        }
+
+        return (2 * atan(value) / M_PI + 1) * 100;
+    }
+
+    case SINOSCOPE_PRECISION_FLOAT: {
+        float px    = sinoscope->dx * j - 2 * (float)M_PI;
+        float py    = sinoscope->dy * i - 2 * (float)M_PI;
+        float value = 0;
+
+        for (int k = 1; k <= sinoscope->taylor; k += 2) {
+            value += sinf(px * k * sinoscope->phase1 + sinoscope->time) / k;
+            value += cosf(py * k * sinoscope->phase0) / k;
+        }
+
+        return (2 * atanf(value) / (float)M_PI + 1) * 100;
+    }
+
+    case SINOSCOPE_PRECISION_NATIVE: {
+        float px    = sinoscope->dx * j - 2 * (float)M_PI;
+        float py    = sinoscope->dy * i - 2 * (float)M_PI;
+        float value = 0;
+
+        for (int k = 1; k <= sinoscope->taylor; k += 2) {
+            value += approx_sincosf(px * k * sinoscope->phase1 + sinoscope->time, 0) / k;
+            value += approx_sincosf(py * k * sinoscope->phase0, 1) / k;
+        }
+
+        return (2 * approx_atanf(value) / (float)M_PI + 1) * 100;
+    }
+
+    case SINOSCOPE_PRECISION_DEFAULT:
+    case SINOSCOPE_PRECISION_COUNT:
+        break;
+    }
+
+    float px    = sinoscope->dx * j - 2 * M_PI;
+    float py    = sinoscope->dy * i - 2 * M_PI;
+    float value = 0;
+
+    for (int k = 1; k <= sinoscope->taylor; k += 2) {
+        value += sin(px * k * sinoscope->phase1 + sinoscope->time) / k;
+        value += cos(py * k * sinoscope->phase0) / k;
+    }
+
+    value = (atan(value) - atan(-value)) / M_PI;
+    return (value + 1) * 100;
+}
+
+#endif /* INCLUDE_SINOSCOPE_PRECISION_H_ */
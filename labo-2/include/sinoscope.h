@@ -3,25 +3,218 @@
 #ifndef INCLUDE_SINOSCOPE_H_
 #define INCLUDE_SINOSCOPE_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "color.h"
 #include "opencl.h"
 
+typedef enum sinoscope_opencl_memory {
+    /* read the device buffer into the sinoscope buffer */
+    SINOSCOPE_OPENCL_MEMORY_COPY,
+    /* render into host visible (pinned) memory and map it for the readback */
+    SINOSCOPE_OPENCL_MEMORY_ALLOC_HOST,
+    /* render straight into the sinoscope buffer, zero-copy on CPU devices */
+    SINOSCOPE_OPENCL_MEMORY_USE_HOST,
+} sinoscope_opencl_memory_t;
+
+/*
+ * Arithmetic of the series and of the final atan. The values are the
+ * `-DSINOSCOPE_PRECISION` of the kernels, keep them in sync with sinoscope.cl.
+ */
+typedef enum sinoscope_precision {
+    /* float values with the double libm on the CPU, float built-ins on the device */
+    SINOSCOPE_PRECISION_DEFAULT = 0,
+    /* double values and functions, the reference of `--check-precision` */
+    SINOSCOPE_PRECISION_DOUBLE = 1,
+    /* float values and functions */
+    SINOSCOPE_PRECISION_FLOAT = 2,
+    /* polynomial approximations on the CPU, native_sin, native_cos and relaxed math on the device */
+    SINOSCOPE_PRECISION_NATIVE = 3,
+    SINOSCOPE_PRECISION_COUNT,
+} sinoscope_precision_t;
+
+/* host buffers the frame ring and the async handler rotate through, with spares */
+#define SINOSCOPE_OPENCL_WRAPPERS 6
+
+/* device buffer created over one host buffer in use-host mode */
+typedef struct sinoscope_opencl_wrapper {
+    const unsigned char* host;
+    cl_mem buffer;
+} sinoscope_opencl_wrapper_t;
+
 typedef struct sinoscope_opencl {
     cl_device_id device_id;
+    /* shared by the instances of sinoscope_opencl_init_shared, released with the last one */
     cl_context context;
+    cl_program program;
     cl_command_queue queue;
     cl_mem buffer;
     cl_kernel kernel;
+
+    /* row and column series of the separable kernels */
+    cl_mem terms;
+    cl_kernel terms_kernel;
+    cl_kernel separable_kernel;
+
+    /* set before sinoscope_opencl_init, only used by the synchronous handlers */
+    sinoscope_opencl_memory_t memory;
+    cl_mem mapped;
+    /* use-host wrappers, kept per host buffer while the buffers rotate */
+    sinoscope_opencl_wrapper_t wrappers[SINOSCOPE_OPENCL_WRAPPERS];
+    /* wrapper given to the next host buffer not in `wrappers` */
+    unsigned int next_wrapper;
+
+    /* color palette in constant memory, uploaded again when the interval changes */
+    cl_mem palette;
+    unsigned int palette_interval;
+
+    /*
+     * 2D kernel computing a strip of pixels per work item. The local size is
+     * set before sinoscope_opencl_init, zero lets the init pick the fastest.
+     */
+    cl_kernel strip_kernel;
+    size_t local_size[2];
+
+    /* values of the kernel arguments that are only set when they change */
+    unsigned int args_taylor;
+    unsigned int args_interval;
+    /* the adaptive mode renders smaller frames with the same context */
+    unsigned int args_width;
+    unsigned int args_height;
+    unsigned int args_pixel_size;
+
+    /*
+     * Double buffering of the async handler: the kernel of a frame runs on
+     * `queue` while the previous frame is read back on `transfer_queue`.
+     */
+    cl_command_queue transfer_queue;
+    cl_mem back_buffer;
+    unsigned char* host_buffers[2];
+    cl_event read_events[2];
+    int in_flight;
+    unsigned int next_slot;
+
+    /* share of the rows rendered by the device in the hybrid handler, adjusted every frame */
+    float hybrid_share;
+
+    /* set before sinoscope_opencl_init, the program is built for it */
+    sinoscope_precision_t precision;
+
+    /* queues created with CL_QUEUE_PROFILING_ENABLE, copied from sinoscope_profile at init */
+    bool profiling;
+    /* kernel of the frame in flight in each slot of the async handler, kept only when profiling */
+    cl_event kernel_events[2];
 } sinoscope_opencl_t;
 
 typedef struct sinoscope sinoscope_t;
 typedef int (*sinoscope_handler)(sinoscope_t* sinoscope);
 
+/* memory layout of the sinoscope buffer, chosen at sinoscope_create */
+typedef enum sinoscope_format {
+    /* packed 3 bytes per pixel */
+    SINOSCOPE_FORMAT_RGB8,
+    /* 4 bytes per pixel with an opaque alpha, every pixel is a 32-bit aligned word */
+    SINOSCOPE_FORMAT_RGBA8,
+} sinoscope_format_t;
+
+/* largest pixel of the formats, the OpenCL buffers are sized for it */
+#define SINOSCOPE_PIXEL_SIZE_MAX 4
+
+/* buffers remembered by the cached handler, the frame ring rotates through three */
+#define SINOSCOPE_CACHE_SLOTS 4
+
+/* what the cached handler last drew into one buffer */
+typedef struct sinoscope_cache_slot {
+    const unsigned char* buffer;
+    /* row series each row was drawn with */
+    float* rows;
+    /* generations the buffer was drawn at, zero when nothing was drawn */
+    unsigned long columns;
+    unsigned long frame;
+} sinoscope_cache_slot_t;
+
+/*
+ * Series kept across frames by the cached handler. A series is computed
+ * again once its argument may have drifted by more than
+ * sinoscope_reuse_tolerance radians, and only the rows whose sum changed
+ * since the buffer was last drawn are drawn again.
+ */
+typedef struct sinoscope_cache {
+    float* columns;
+    float* rows;
+    unsigned char* dirty;
+    sinoscope_cache_slot_t slots[SINOSCOPE_CACHE_SLOTS];
+    /* slot given to the next buffer not in `slots` */
+    unsigned int next_slot;
+    /* bumped whenever the columns, or any series, are computed again */
+    unsigned long columns_generation;
+    unsigned long frame_generation;
+    unsigned int taylor;
+    float phase0;
+    float phase1;
+    float time;
+    bool columns_valid;
+    bool rows_valid;
+} sinoscope_cache_t;
+
+/*
+ * set by `--reuse-tolerance`, zero only reuses a series whose inputs did
+ * not change, which the phases of an animation never allow
+ */
+extern float sinoscope_reuse_tolerance;
+
+/* parts of a frame timed by the handlers that can tell them apart */
+typedef enum sinoscope_phase {
+    /* device time of the kernels, from the OpenCL profiling events */
+    SINOSCOPE_PHASE_KERNEL,
+    /* device time of the read or map, plus the host copy out of a mapping */
+    SINOSCOPE_PHASE_READBACK,
+    /* host time setting the arguments and enqueueing the commands */
+    SINOSCOPE_PHASE_ENQUEUE,
+    /* OpenMP loops up to the one doing the palette lookups, then that loop */
+    SINOSCOPE_PHASE_COMPUTE,
+    SINOSCOPE_PHASE_COLORIZE,
+    SINOSCOPE_PHASE_COUNT,
+} sinoscope_phase_t;
+
+/*
+ * Set by `--profile` before the OpenCL init. The handlers then fill the
+ * phases of every frame and the benchmarks report their distribution.
+ */
+extern bool sinoscope_profile;
+
+/* set by `--precision`, the precision of the sinoscopes created afterwards */
+extern sinoscope_precision_t sinoscope_precision;
+
+/*
+ * Quality control of the interactive modes. While frames take longer than
+ * 1 / target_fps they are rendered at a lower resolution, then with fewer
+ * taylor terms, and upscaled into the sinoscope buffer. Quality is raised
+ * again once the next level is expected to fit the frame time.
+ */
+typedef struct sinoscope_adaptive {
+    /* set by `--target-fps`, zero always renders at full quality */
+    float target_fps;
+    unsigned int level;
+    /* consecutive frames over the budget, or with room for the next level */
+    unsigned int slow_frames;
+    unsigned int fast_frames;
+    /* reduced resolution sinoscope, created again when the scale changes */
+    sinoscope_t* low;
+} sinoscope_adaptive_t;
+
 typedef struct sinoscope {
     const char* name;
     sinoscope_handler handler;
 
     unsigned int buffer_size;
     unsigned char* buffer;
+    sinoscope_format_t format;
+    unsigned int pixel_size;
+    /* OpenCL handlers require the precision the context was built for */
+    sinoscope_precision_t precision;
 
     unsigned int width;
     unsigned int height;
@@ -29,6 +222,7 @@ typedef struct sinoscope {
 
     unsigned int interval;
     float interval_inverse;
+    pixel_t palette[COLOR_PALETTE_SIZE];
 
     float time;
     float max;
@@ -38,27 +232,225 @@ typedef struct sinoscope {
     float dy;
 
     sinoscope_opencl_t* opencl;
+    /* microseconds of the last frame, negative for the phases its handler did not time */
+    double phases[SINOSCOPE_PHASE_COUNT];
+    sinoscope_cache_t cache;
+    /* column coordinates, then column values, of the simd handler, allocated on its first frame */
+    float* simd_columns;
+    sinoscope_adaptive_t adaptive;
 } sinoscope_t;
 
+/* parameters of a method varied by the sweep */
+typedef enum sinoscope_tunable {
+    SINOSCOPE_TUNE_THREADS  = 1 << 0,
+    SINOSCOPE_TUNE_SCHEDULE = 1 << 1,
+    SINOSCOPE_TUNE_LOCAL    = 1 << 2,
+} sinoscope_tunable_t;
+
+/* animation state of one frame, as left by sinoscope_corners */
+typedef struct sinoscope_frame {
+    float time;
+    float phase0;
+    float phase1;
+} sinoscope_frame_t;
+
+typedef struct sinoscope_method {
+    /* accepted by `--method`, also used as benchmark label */
+    char* name;
+    /* short name accepted by `--benchmark` and `--check` */
+    char* variant;
+    sinoscope_handler handler;
+    bool opencl;
+    /* largest per-byte difference allowed against the serial output */
+    long long max_diff;
+    /* mask of sinoscope_tunable_t */
+    unsigned int tunables;
+    /* also renders SINOSCOPE_FORMAT_RGBA8, every method renders SINOSCOPE_FORMAT_RGB8 */
+    bool rgba8;
+    /* follows sinoscope_precision_t, the others always render SINOSCOPE_PRECISION_DEFAULT */
+    bool precisions;
+} sinoscope_method_t;
+
+#define SINOSCOPE_SWEEP_MAX 16
+
+typedef struct sinoscope_sweep {
+    unsigned int sizes[SINOSCOPE_SWEEP_MAX][2];
+    unsigned int size_count;
+    unsigned int taylors[SINOSCOPE_SWEEP_MAX];
+    unsigned int taylor_count;
+    /* zero is the openmp default */
+    unsigned int threads[SINOSCOPE_SWEEP_MAX];
+    unsigned int thread_count;
+    char schedules[SINOSCOPE_SWEEP_MAX][16];
+    unsigned int schedule_count;
+    /* {0, 0} keeps the size picked by sinoscope_opencl_init */
+    size_t local_sizes[SINOSCOPE_SWEEP_MAX][2];
+    unsigned int local_size_count;
+    /* zero runs every method */
+    const sinoscope_method_t* methods[SINOSCOPE_SWEEP_MAX];
+    unsigned int method_count;
+
+    unsigned int warmup;
+    unsigned int trials;
+    bool json;
+    /* fastest configuration of every size and taylor degree, read back by sinoscope_sweep_load */
+    char* best_path;
+} sinoscope_sweep_t;
+
+/* configuration of a method as saved by the sweep, unused fields are zero or empty */
+typedef struct sinoscope_tuning {
+    char method[32];
+    unsigned int threads;
+    char schedule[16];
+    size_t local_size[2];
+} sinoscope_tuning_t;
+
+extern const sinoscope_method_t sinoscope_methods[];
+extern const unsigned int sinoscope_method_count;
+
+/* matches either the name or the variant of a method */
+const sinoscope_method_t* sinoscope_find_method(const char* name);
+/* returns -1 on unknown names, accepts rgb8 and rgba8 */
+int sinoscope_parse_format(const char* name, sinoscope_format_t* format);
+const char* sinoscope_format_name(sinoscope_format_t format);
+const char* sinoscope_phase_name(sinoscope_phase_t phase);
+/* returns -1 on unknown names, accepts default, double, float and native */
+int sinoscope_parse_precision(const char* name, sinoscope_precision_t* precision);
+const char* sinoscope_precision_name(sinoscope_precision_t precision);
+bool sinoscope_method_supports(const sinoscope_method_t* method, sinoscope_format_t format);
+bool sinoscope_method_renders(const sinoscope_method_t* method, sinoscope_precision_t precision);
+/* switches the handler of a running sinoscope, returns -1 and keeps the current one if the method cannot render it */
+int sinoscope_select_method(sinoscope_t* sinoscope, const char* name);
+
+/* stores the pixel at `index`, in pixels, with the layout of `format` */
+static inline void sinoscope_store_pixel(unsigned char* buffer, size_t index, const pixel_t* pixel,
+                                         sinoscope_format_t format) {
+    if (format == SINOSCOPE_FORMAT_RGBA8) {
+        /* a single 32-bit store once the compiler merges the bytes */
+        const unsigned char rgba[4] = {pixel->bytes[0], pixel->bytes[1], pixel->bytes[2], 255};
+        memcpy(&buffer[index * 4], rgba, sizeof(rgba));
+        return;
+    }
+
+    buffer[index * 3 + 0] = pixel->bytes[0];
+    buffer[index * 3 + 1] = pixel->bytes[1];
+    buffer[index * 3 + 2] = pixel->bytes[2];
+}
+
 sinoscope_t* sinoscope_create(char* name, sinoscope_handler handler, unsigned int width, unsigned int height,
-                              float max);
+                              float max, sinoscope_format_t format);
 void sinoscope_destroy(sinoscope_t* sinoscope);
+/* bytes given to a buffer of `size` bytes by sinoscope_alloc_buffer, a whole number of pages */
+size_t sinoscope_buffer_allocation(size_t size);
+/* cleared page aligned buffer the handlers can render into, released with free */
+unsigned char* sinoscope_alloc_buffer(size_t size);
 int sinoscope_corners(sinoscope_t* sinoscope);
+/* calls the handler, through the adaptive quality levels when a target fps is set */
+int sinoscope_render_adaptive(sinoscope_t* sinoscope);
 int sinoscope_check(unsigned int width, unsigned int height, unsigned int taylor, float max,
                     sinoscope_opencl_t* opencl);
+int sinoscope_check_handler(char* name, sinoscope_handler handler, unsigned int width, unsigned int height,
+                            unsigned int taylor, float max, sinoscope_format_t format, sinoscope_opencl_t* opencl,
+                            long long max_diff);
+/*
+ * Renders `frames` frames of `method` with every precision and reports the
+ * error and the frame time against serial in double precision. OpenCL
+ * methods build a context per precision on the device of `opencl`.
+ */
+int sinoscope_check_precision(const sinoscope_method_t* method, unsigned int width, unsigned int height,
+                              unsigned int taylor, float max, const sinoscope_opencl_t* opencl, unsigned int frames);
+/* methods without the `format` layout are skipped */
 int sinoscope_benchmarks(unsigned int width, unsigned int height, unsigned int taylor, float max,
-                        sinoscope_opencl_t* opencl, unsigned int iterations);
+                        sinoscope_format_t format, sinoscope_opencl_t* opencl, unsigned int iterations);
 
 int sinoscope_benchmark(sinoscope_t* sinoscope, unsigned int iterations);
 
+void sinoscope_sweep_defaults(sinoscope_sweep_t* sweep);
+/* `key` is the option name without the `--sweep-` prefix, `value` is a comma separated list */
+int sinoscope_sweep_option(sinoscope_sweep_t* sweep, const char* key, const char* value);
+/* OpenCL methods are skipped when `device_id` is NULL, the context is created again for every size */
+int sinoscope_sweep(const sinoscope_sweep_t* sweep, const char* path, const cl_device_id* device_id,
+                    sinoscope_opencl_memory_t memory, float max);
+/* returns 1 and fills `tuning` when `path` has an entry for the size, 0 otherwise */
+int sinoscope_sweep_load(const char* path, unsigned int width, unsigned int height, unsigned int taylor,
+                         sinoscope_tuning_t* tuning);
+
 int sinoscope_image_serial(sinoscope_t* sinoscope);
 int sinoscope_image_openmp(sinoscope_t* sinoscope);
 int sinoscope_image_opencl(sinoscope_t* sinoscope);
+int sinoscope_image_simd(sinoscope_t* sinoscope);
+int sinoscope_image_serial_separable(sinoscope_t* sinoscope);
+int sinoscope_image_openmp_separable(sinoscope_t* sinoscope);
+int sinoscope_image_opencl_separable(sinoscope_t* sinoscope);
+int sinoscope_image_opencl_async(sinoscope_t* sinoscope);
+int sinoscope_image_opencl_2d(sinoscope_t* sinoscope);
+int sinoscope_image_openmp_tiled(sinoscope_t* sinoscope);
+int sinoscope_image_openmp_cached(sinoscope_t* sinoscope);
+int sinoscope_image_opencl_hybrid(sinoscope_t* sinoscope);
+int sinoscope_image_openmp_tasks(sinoscope_t* sinoscope);
+/* renders `count` frames at once, frames x columns then frames x rows */
+int sinoscope_openmp_render_batch(sinoscope_t* sinoscope, const sinoscope_frame_t* frames, unsigned char** buffers,
+                                  unsigned int count);
+/* renders rows [first, last) of the frame, the other rows are left untouched */
+int sinoscope_openmp_render_rows(sinoscope_t* sinoscope, unsigned int first, unsigned int last);
+
+/* schedule is static, dynamic or guided; zero keeps the default chunk and tile sizes */
+int sinoscope_openmp_configure(const char* schedule, unsigned int chunk, unsigned int tile_width,
+                               unsigned int tile_height);
+/* zero restores the default thread count */
+int sinoscope_openmp_set_threads(unsigned int threads);
+unsigned int sinoscope_openmp_max_threads(void);
+/* clears the buffer from the threads that render it, called on every buffer of sinoscope_alloc_buffer */
+void sinoscope_openmp_first_touch(unsigned char* buffer, size_t size);
+/* binding policy and places the runtime read from OMP_PROC_BIND and OMP_PLACES */
+void sinoscope_openmp_print_placement(void);
 
 int sinoscope_opencl_init(sinoscope_opencl_t* opencl, cl_device_id opencl_device_id, unsigned int width,
                           unsigned int height);
+/*
+ * Another instance on the context and program of `parent`, with its own
+ * queues, buffers and kernels for a sinoscope of another size.
+ */
+int sinoscope_opencl_init_shared(sinoscope_opencl_t* opencl, const sinoscope_opencl_t* parent, unsigned int width,
+                                 unsigned int height);
 void sinoscope_opencl_cleanup(sinoscope_opencl_t* opencl);
+const char* sinoscope_opencl_memory_name(sinoscope_opencl_memory_t memory);
+/* fails when the device cannot run work groups of `local_size` */
+int sinoscope_opencl_set_local_size(sinoscope_opencl_t* opencl, const size_t* local_size);
+/* waits for the frame still in flight in async mode and makes it the current buffer */
+int sinoscope_opencl_drain(sinoscope_t* sinoscope);
 
 int sinoscope_save_image(sinoscope_t* sinoscope, char* filename);
+/*
+ * Renders every frame into its own buffer, at once on the openmp batch
+ * path when the method has one, otherwise one by one with the handler.
+ */
+int sinoscope_render_frames(sinoscope_t* sinoscope, const sinoscope_frame_t* frames, unsigned char** buffers,
+                            unsigned int count);
+/*
+ * Renders `frames` frames, `batch` at a time, and encodes them as PNG files
+ * named after the printf `pattern` of the frame index on `jobs` threads.
+ * With a non NULL `raw`, the packed RGB frames are written to it in order.
+ */
+int sinoscope_export(sinoscope_t* sinoscope, const char* pattern, FILE* raw, unsigned int frames, unsigned int batch,
+                     unsigned int jobs);
+
+#define SINOSCOPE_DRIVER_MAX 16
+
+/* one sinoscope of the driver mode */
+typedef struct sinoscope_driver_instance {
+    unsigned int width;
+    unsigned int height;
+    unsigned int taylor;
+    float max;
+} sinoscope_driver_instance_t;
+
+/*
+ * Renders `frames` frames of every instance at the same time, one thread
+ * each. OpenCL methods share the context and program of `opencl`, every
+ * instance submits to its own command queues.
+ */
+int sinoscope_driver(const char* method, const sinoscope_driver_instance_t* instances, unsigned int count,
+                     unsigned int frames, sinoscope_format_t format, sinoscope_opencl_t* opencl);
 
 #endif /* INCLUDE_SINOSCOPE_H_ */
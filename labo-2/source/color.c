@@ -62,3 +62,9 @@ void color_value(pixel_t* pixel, float value, int interval, float interval_inver
 done:
     *pixel = pixel_value;
 }
+
+void color_palette(pixel_t* palette, int interval, float interval_inverse) {
+    for (int i = 0; i < COLOR_PALETTE_SIZE; i++) {
+        color_value(&palette[i], i, interval, interval_inverse);
+    }
+}
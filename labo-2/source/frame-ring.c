@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame-ring.h"
+#include "log.h"
+#include "sinoscope.h"
+
+static const unsigned int FRAME_RING_FRESH = 0x4;
+
+int frame_ring_init(frame_ring_t* ring, size_t size) {
+    if (ring == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+
+    for (unsigned int i = 0; i < 3; i++) {
+        ring->buffers[i] = sinoscope_alloc_buffer(size);
+        if (ring->buffers[i] == NULL) {
+            LOG_ERROR("failed to allocate frame ring buffer");
+            goto fail_destroy_ring;
+        }
+    }
+
+    ring->back  = 0;
+    ring->ready = 1;
+    ring->front = 2;
+
+    return 0;
+
+fail_destroy_ring:
+    frame_ring_destroy(ring);
+fail_exit:
+    return -1;
+}
+
+void frame_ring_destroy(frame_ring_t* ring) {
+    if (ring == NULL) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < 3; i++) {
+        free(ring->buffers[i]);
+        ring->buffers[i] = NULL;
+    }
+}
+
+void frame_ring_publish(frame_ring_t* ring) {
+    unsigned int previous = __atomic_exchange_n(&ring->ready, ring->back | FRAME_RING_FRESH, __ATOMIC_ACQ_REL);
+
+    if (previous & FRAME_RING_FRESH) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+    }
+
+    ring->back = previous & ~FRAME_RING_FRESH;
+}
+
+const unsigned char* frame_ring_acquire(frame_ring_t* ring, bool* fresh) {
+    /* only the renderer can set the flag again, the exchange below always takes a new frame */
+    bool available = __atomic_load_n(&ring->ready, __ATOMIC_ACQUIRE) & FRAME_RING_FRESH;
+
+    if (available) {
+        unsigned int previous = __atomic_exchange_n(&ring->ready, ring->front, __ATOMIC_ACQ_REL);
+        ring->front           = previous & ~FRAME_RING_FRESH;
+    } else {
+        __atomic_fetch_add(&ring->duplicated, 1, __ATOMIC_RELAXED);
+    }
+
+    if (fresh != NULL) {
+        *fresh = available;
+    }
+
+    return ring->buffers[ring->front];
+}
+
+void frame_ring_counters(frame_ring_t* ring, long* dropped, long* duplicated) {
+    *dropped    = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+    *duplicated = __atomic_exchange_n(&ring->duplicated, 0, __ATOMIC_RELAXED);
+}
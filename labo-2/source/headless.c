@@ -5,16 +5,22 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "frame-ring.h"
 #include "headless.h"
 #include "log.h"
 
 typedef struct timespec timespec_t;
 typedef struct termios termios_t;
 
+/* frames are taken at the rate of a 60 Hz display */
+static const long present_interval_ns = 1000000000 / 60;
+
 typedef struct headless {
     sinoscope_t* sinoscope;
+    frame_ring_t ring;
     bool exit;
 
     long fps_count;
@@ -35,10 +41,19 @@ static void* sinoscope_thread_loop(void* data) {
             LOG_ERROR("failed to forward sinoscope");
         }
 
-        if (headless->sinoscope->handler(headless->sinoscope) < 0) {
+        unsigned char* back         = frame_ring_back(&headless->ring);
+        headless->sinoscope->buffer = back;
+
+        if (sinoscope_render_adaptive(headless->sinoscope) < 0) {
             LOG_ERROR("failed to call sinoscope handler `%s`\n\r", headless->sinoscope->name);
         }
 
+        /* the async handler, or the drain when leaving it, hands over a completed buffer */
+        if (headless->sinoscope->buffer != back) {
+            frame_ring_adopt_back(&headless->ring, headless->sinoscope->buffer);
+        }
+
+        frame_ring_publish(&headless->ring);
         headless->fps_count++;
 
         __atomic_load(&headless->exit, &exit, __ATOMIC_ACQUIRE);
@@ -48,6 +63,29 @@ done:
     return NULL;
 }
 
+/* stands for the display, there is nothing to show the frames on */
+static void* present_thread_loop(void* data) {
+    if (data == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto done;
+    }
+
+    headless_t* headless = data;
+    timespec_t interval  = {.tv_sec = 0, .tv_nsec = present_interval_ns};
+    bool exit            = false;
+
+    while (!exit) {
+        frame_ring_acquire(&headless->ring, NULL);
+
+        nanosleep(&interval, NULL);
+
+        __atomic_load(&headless->exit, &exit, __ATOMIC_ACQUIRE);
+    }
+
+done:
+    return NULL;
+}
+
 static void* fps_thread_loop(void* data) {
     if (data == NULL) {
         LOG_ERROR_NULL_PTR();
@@ -68,7 +106,11 @@ static void* fps_thread_loop(void* data) {
         float end_sec   = fps_end.tv_sec + fps_end.tv_nsec / 1e9;
         float diff_sec  = end_sec - start_sec;
 
-        printf("FPS: %2.2f\n", (float)headless->fps_count / diff_sec);
+        long dropped, duplicated;
+        frame_ring_counters(&headless->ring, &dropped, &duplicated);
+
+        printf("FPS: %2.2f (dropped: %ld, duplicated: %ld)\n", (float)headless->fps_count / diff_sec, dropped,
+               duplicated);
         headless->fps_count = 0;
         headless->fps_start = fps_end;
 
@@ -81,6 +123,15 @@ done:
     return NULL;
 }
 
+static void select_method(sinoscope_t* sinoscope, const char* name) {
+    if (sinoscope_select_method(sinoscope, name) < 0) {
+        printf("Method %s cannot render this frame, keeping %s\n", name, sinoscope->name);
+        return;
+    }
+
+    printf("Selected %s implementation\n", name);
+}
+
 static void handle_input_loop(sinoscope_t* sinoscope) {
     termios_t term_old;
     termios_t term_new;
@@ -101,19 +152,16 @@ static void handle_input_loop(sinoscope_t* sinoscope) {
             exit = true;
             break;
         case '1':
-            printf("Selected serial implementation\n");
-            sinoscope->name    = "serial";
-            sinoscope->handler = sinoscope_image_serial;
+            select_method(sinoscope, "serial");
             break;
         case '2':
-            printf("Selected openmp implementation\n");
-            sinoscope->name    = "openmp";
-            sinoscope->handler = sinoscope_image_openmp;
+            select_method(sinoscope, "openmp");
             break;
         case '3':
-            printf("Selected opencl implementation\n");
-            sinoscope->name    = "opencl";
-            sinoscope->handler = sinoscope_image_opencl;
+            select_method(sinoscope, "opencl");
+            break;
+        case '4':
+            select_method(sinoscope, "simd");
             break;
         default:
             break;
@@ -140,7 +188,16 @@ int headless_run(sinoscope_t* sinoscope) {
         goto fail_exit;
     }
 
+    if (frame_ring_init(&headless.ring, sinoscope->buffer_size) < 0) {
+        LOG_ERROR("failed to initialise frame ring");
+        goto fail_exit;
+    }
+
+    /* the handlers render into the ring while it runs */
+    unsigned char* buffer = sinoscope->buffer;
+
     pthread_t sinoscope_thread;
+    pthread_t present_thread;
     pthread_t fps_thread;
 
     errno = pthread_create(&sinoscope_thread, NULL, sinoscope_thread_loop, &headless);
@@ -148,6 +205,11 @@ int headless_run(sinoscope_t* sinoscope) {
         LOG_ERROR_ERRNO("pthread_create");
     }
 
+    errno = pthread_create(&present_thread, NULL, present_thread_loop, &headless);
+    if (errno != 0) {
+        LOG_ERROR_ERRNO("pthread_create");
+    }
+
     errno = pthread_create(&fps_thread, NULL, fps_thread_loop, &headless);
     if (errno != 0) {
         LOG_ERROR_ERRNO("pthread_create");
@@ -163,11 +225,19 @@ int headless_run(sinoscope_t* sinoscope) {
         LOG_ERROR_ERRNO("pthread_join");
     }
 
+    errno = pthread_join(present_thread, NULL);
+    if (errno != 0) {
+        LOG_ERROR_ERRNO("pthread_join");
+    }
+
     errno = pthread_join(fps_thread, NULL);
     if (errno != 0) {
         LOG_ERROR_ERRNO("pthread_join");
     }
 
+    sinoscope->buffer = buffer;
+    frame_ring_destroy(&headless.ring);
+
     return 0;
 
 fail_exit:
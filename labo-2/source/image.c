@@ -137,3 +137,81 @@ fail_close_file:
 fail_exit:
     return -1;
 }
+
+int image_save_png_packed(const unsigned char* buffer, size_t width, size_t height, unsigned int channels,
+                          const char* filename) {
+    if (buffer == NULL || filename == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    if (channels != 3 && channels != 4) {
+        LOG_ERROR("unsupported channel count %u", channels);
+        goto fail_exit;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        LOG_ERROR_ERRNO("fopen");
+        goto fail_exit;
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (png == NULL) {
+        LOG_ERROR("couldn't create png_struct");
+        goto fail_close_file;
+    }
+
+    png_infop info = png_create_info_struct(png);
+    if (info == NULL) {
+        LOG_ERROR("couldn't create png_infop");
+        goto fail_free_png_struct;
+    }
+
+    /* the rows point into the buffer, libpng never writes through them */
+    png_bytep* row_pointers = malloc(height * sizeof(*row_pointers));
+    if (row_pointers == NULL) {
+        LOG_ERROR_ERRNO("malloc");
+        goto fail_free_png_info;
+    }
+
+    for (size_t j = 0; j < height; j++) {
+        row_pointers[j] = (png_bytep)buffer + j * width * channels;
+    }
+
+    if (setjmp(png_jmpbuf(png))) {
+        goto fail_free_rows;
+    }
+
+    png_init_io(png, file);
+
+    int color_type = (channels == 4) ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB;
+    png_set_IHDR(png, info, width, height, 8, color_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+
+    png_write_info(png, info);
+    png_write_image(png, row_pointers);
+    png_write_end(png, NULL);
+
+    free(row_pointers);
+    png_destroy_write_struct(&png, &info);
+
+    if (fclose(file) != 0) {
+        LOG_ERROR_ERRNO("fclose");
+        goto fail_exit;
+    }
+
+    return 0;
+
+fail_free_rows:
+    free(row_pointers);
+fail_free_png_info:
+    png_destroy_write_struct(&png, &info);
+    goto fail_close_file;
+fail_free_png_struct:
+    png_destroy_write_struct(&png, NULL);
+fail_close_file:
+    fclose(file);
+fail_exit:
+    return -1;
+}
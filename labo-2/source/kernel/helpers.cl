@@ -55,4 +55,15 @@ void color_value(pixel_t* pixel, float value, int interval, float interval_inver
 
 done:
     *pixel = pixel_value;
-}
\ No newline at end of file
+}
+
+// same size as COLOR_PALETTE_SIZE in color.h
+#define COLOR_PALETTE_SIZE 201
+
+pixel_t color_lookup(__constant const pixel_t* palette, float value) {
+    if (isnan(value)) {
+        return pixel_black;
+    }
+
+    return palette[clamp((int)value, 0, COLOR_PALETTE_SIZE - 1)];
+}
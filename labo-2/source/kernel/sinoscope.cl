@@ -1,38 +1,164 @@
 #include "helpers.cl"
 
+// values of sinoscope_precision_t, set with -DSINOSCOPE_PRECISION by sinoscope-opencl.c
+#ifndef SINOSCOPE_PRECISION
+#define SINOSCOPE_PRECISION 0
+#endif
+
+#if SINOSCOPE_PRECISION == 1
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+typedef double real_t;
+#define SIN sin
+#define COS cos
+#elif SINOSCOPE_PRECISION == 3
+// the program is also built with -cl-fast-relaxed-math
+typedef float real_t;
+#define SIN native_sin
+#define COS native_cos
+#else
+typedef float real_t;
+#define SIN sin
+#define COS cos
+#endif
+
 typedef struct modified_sinoscope {
     unsigned int buffer_size;
     unsigned int width;
     unsigned int height;
     unsigned int taylor;
     unsigned int interval;
+    // 3 for packed RGB, 4 for RGBA with an opaque alpha
+    unsigned int pixel_size;
 } modified_sinoscope_t;
 
 // create a kernel with opencl
-__kernel void sinoscope_image_kernel(__global unsigned char* buffer, modified_sinoscope_t mod_sinoscope, float interval_inverse, float time, float max, float phase0, float phase1, float dx, float dy) {
+__kernel void sinoscope_image_kernel(__global unsigned char* buffer, modified_sinoscope_t mod_sinoscope, float interval_inverse, float time, float max, float phase0, float phase1, float dx, float dy, __constant const pixel_t* palette) {
     
     int id = get_global_id(0);
-    int j = (int) id / mod_sinoscope.height;
-    int i = (int) id % mod_sinoscope.height;
+    int j = (int) id / mod_sinoscope.width;
+    int i = (int) id % mod_sinoscope.width;
 
-    float px = dx * j - 2 * M_PI;
-    float py = dy * i - 2 * M_PI;
-    float value = 0;
+    real_t px = (real_t)dx * j - 2 * M_PI;
+    real_t py = (real_t)dy * i - 2 * M_PI;
+    real_t value = 0;
 
     for (int k = 1; k <= mod_sinoscope.taylor; k += 2) {
-        value += sin(px * k * phase1 + time) / k;
-        value += cos(py * k * phase0) / k;
+        value += SIN(px * k * phase1 + time) / k;
+        value += COS(py * k * phase0) / k;
     }
 
     value = (atan(value) - atan(-value)) / M_PI;
     value = (value + 1) * 100;
 
-    pixel_t pixel;
-    color_value(&pixel, value, mod_sinoscope.interval, interval_inverse);
+    pixel_t pixel = color_lookup(palette, value);
+
+    if (mod_sinoscope.pixel_size == 4) {
+        // one aligned 32-bit store per pixel
+        vstore4((uchar4)(pixel.bytes[0], pixel.bytes[1], pixel.bytes[2], 255), id, buffer);
+        return;
+    }
+
+    int index = (i * 3) + (j * 3) * mod_sinoscope.width;
+
+    buffer[index + 0] = pixel.bytes[0];
+    buffer[index + 1] = pixel.bytes[1];
+    buffer[index + 2] = pixel.bytes[2];
+}
+
+// same as STRIP_WIDTH in sinoscope-opencl.c
+#define STRIP_WIDTH 4
+
+// 2D variant: one work item per horizontal strip of a row, the global size is rounded up to the local size
+__kernel void sinoscope_strip_kernel(__global unsigned char* buffer, modified_sinoscope_t mod_sinoscope, float interval_inverse, float time, float max, float phase0, float phase1, float dx, float dy, __constant const pixel_t* palette) {
+    int i0 = get_global_id(0) * STRIP_WIDTH;
+    int j = get_global_id(1);
+
+    if (i0 >= mod_sinoscope.width || j >= mod_sinoscope.height) {
+        return;
+    }
+
+    // the sin series only depends on the row, it is shared by the whole strip
+    real_t px = (real_t)dx * j - 2 * M_PI;
+    real_t row = 0;
+
+    for (int k = 1; k <= mod_sinoscope.taylor; k += 2) {
+        row += SIN(px * k * phase1 + time) / k;
+    }
+
+    uchar strip[STRIP_WIDTH * 4];
+    int pixel_size = mod_sinoscope.pixel_size;
+
+    for (int s = 0; s < STRIP_WIDTH; s++) {
+        real_t py = (real_t)dy * (i0 + s) - 2 * M_PI;
+        real_t value = row;
+
+        for (int k = 1; k <= mod_sinoscope.taylor; k += 2) {
+            value += COS(py * k * phase0) / k;
+        }
+
+        value = (atan(value) - atan(-value)) / M_PI;
+        value = (value + 1) * 100;
+
+        pixel_t pixel = color_lookup(palette, value);
+
+        strip[s * pixel_size + 0] = pixel.bytes[0];
+        strip[s * pixel_size + 1] = pixel.bytes[1];
+        strip[s * pixel_size + 2] = pixel.bytes[2];
+        strip[s * pixel_size + 3] = 255;
+    }
+
+    __global uchar* out = buffer + (i0 + j * mod_sinoscope.width) * pixel_size;
+
+    if (i0 + STRIP_WIDTH <= mod_sinoscope.width && pixel_size == 4) {
+        // 16 bytes aligned on 16, a single vector store
+        vstore16(vload16(0, strip), 0, out);
+    } else if (i0 + STRIP_WIDTH <= mod_sinoscope.width) {
+        // 12 contiguous bytes, two vector stores instead of 12 byte stores
+        vstore8(vload8(0, strip), 0, out);
+        vstore4(vload4(0, strip + 8), 0, out + 8);
+    } else {
+        for (int b = 0; b < (mod_sinoscope.width - i0) * pixel_size; b++) {
+            out[b] = strip[b];
+        }
+    }
+}
+
+// one work item per column (cos series) then per row (sin series)
+__kernel void sinoscope_terms_kernel(__global real_t* terms, modified_sinoscope_t mod_sinoscope, float time, float phase0, float phase1, float dx, float dy) {
+    int id = get_global_id(0);
+    real_t value = 0;
+
+    if (id < mod_sinoscope.width) {
+        real_t py = (real_t)dy * id - 2 * M_PI;
+
+        for (int k = 1; k <= mod_sinoscope.taylor; k += 2) {
+            value += COS(py * k * phase0) / k;
+        }
+    } else {
+        real_t px = (real_t)dx * (id - mod_sinoscope.width) - 2 * M_PI;
+
+        for (int k = 1; k <= mod_sinoscope.taylor; k += 2) {
+            value += SIN(px * k * phase1 + time) / k;
+        }
+    }
+
+    terms[id] = value;
+}
+
+__kernel void sinoscope_separable_kernel(__global unsigned char* buffer, __global const real_t* terms, modified_sinoscope_t mod_sinoscope, float interval_inverse, __constant const pixel_t* palette) {
+    int i = get_global_id(0);
+    int j = get_global_id(1);
+
+    real_t value = terms[i] + terms[mod_sinoscope.width + j];
+
+    value = (atan(value) - atan(-value)) / M_PI;
+    value = (value + 1) * 100;
+
+    pixel_t pixel = color_lookup(palette, value);
 
     int index = (i * 3) + (j * 3) * mod_sinoscope.width;
 
     buffer[index + 0] = pixel.bytes[0];
     buffer[index + 1] = pixel.bytes[1];
     buffer[index + 2] = pixel.bytes[2];
-}
\ No newline at end of file
+}
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #ifdef WITH_VIEWER
 #include <GL/glut.h>
@@ -12,18 +13,82 @@
 
 #include "headless.h"
 #include "log.h"
+#include "opencl-cache.h"
 #include "opencl.h"
+#include "server.h"
 #include "sinoscope.h"
 #include "viewer.h"
 
 __attribute__((weak))
 char* opencl_kernel_path;
 
+__attribute__((weak))
+char* opencl_cache_dir;
+
+__attribute__((weak))
+bool opencl_cache_enabled;
+
 __attribute__((weak))
 int sinoscope_image_openmp(sinoscope_t* sinoscope) {
 	return -1;
 }
 
+__attribute__((weak))
+int sinoscope_image_openmp_separable(sinoscope_t* sinoscope) {
+	return -1;
+}
+
+__attribute__((weak))
+int sinoscope_image_openmp_tiled(sinoscope_t* sinoscope) {
+	return -1;
+}
+
+__attribute__((weak))
+int sinoscope_image_openmp_cached(sinoscope_t* sinoscope) {
+	return -1;
+}
+
+__attribute__((weak))
+int sinoscope_image_openmp_tasks(sinoscope_t* sinoscope) {
+	return -1;
+}
+
+__attribute__((weak))
+void sinoscope_openmp_first_touch(unsigned char* buffer, size_t size) {
+	memset(buffer, 0, size);
+}
+
+__attribute__((weak))
+void sinoscope_openmp_print_placement(void) {
+}
+
+__attribute__((weak))
+int sinoscope_openmp_render_batch(sinoscope_t* sinoscope, const sinoscope_frame_t* frames, unsigned char** buffers,
+				  unsigned int count) {
+	return -1;
+}
+
+__attribute__((weak))
+int sinoscope_openmp_render_rows(sinoscope_t* sinoscope, unsigned int first, unsigned int last) {
+	return -1;
+}
+
+__attribute__((weak))
+int sinoscope_openmp_configure(const char* schedule, unsigned int chunk, unsigned int tile_width,
+			       unsigned int tile_height) {
+	return 0;
+}
+
+__attribute__((weak))
+int sinoscope_openmp_set_threads(unsigned int threads) {
+	return 0;
+}
+
+__attribute__((weak))
+unsigned int sinoscope_openmp_max_threads(void) {
+	return 1;
+}
+
 __attribute__((weak)) int viewer_init(sinoscope_t* sinoscope) {
     return 0;
 }
@@ -42,6 +107,12 @@ int sinoscope_opencl_init(sinoscope_opencl_t* opencl, cl_device_id opencl_device
 	return 0;
 }
 
+__attribute__((weak))
+int sinoscope_opencl_init_shared(sinoscope_opencl_t* opencl, const sinoscope_opencl_t* parent, unsigned int width,
+				 unsigned int height) {
+	return 0;
+}
+
 __attribute__((weak))
 void sinoscope_opencl_cleanup(sinoscope_opencl_t* opencl)
 {
@@ -53,6 +124,41 @@ int sinoscope_image_opencl(sinoscope_t* sinoscope) {
 	return 0;
 }
 
+__attribute__((weak))
+int sinoscope_image_opencl_separable(sinoscope_t* sinoscope) {
+	return 0;
+}
+
+__attribute__((weak))
+int sinoscope_image_opencl_async(sinoscope_t* sinoscope) {
+	return 0;
+}
+
+__attribute__((weak))
+int sinoscope_image_opencl_2d(sinoscope_t* sinoscope) {
+	return 0;
+}
+
+__attribute__((weak))
+int sinoscope_image_opencl_hybrid(sinoscope_t* sinoscope) {
+	return 0;
+}
+
+__attribute__((weak))
+int sinoscope_opencl_drain(sinoscope_t* sinoscope) {
+	return 0;
+}
+
+__attribute__((weak))
+const char* sinoscope_opencl_memory_name(sinoscope_opencl_memory_t memory) {
+	return "copy";
+}
+
+__attribute__((weak))
+int sinoscope_opencl_set_local_size(sinoscope_opencl_t* opencl, const size_t* local_size) {
+	return 0;
+}
+
 __attribute__((weak))
 int opencl_load_kernel_code(char** code, size_t* len)
 {
@@ -81,9 +187,7 @@ static void show_help(FILE* f, const char* exec_name) {
     fprintf(f, "Usage: %s [OPTION]...\n", exec_name);
     fprintf(f, "\n");
     fprintf(f, "Options:\n");
-    fprintf(f,
-            "  --method [serial|openmp|opencl] computation method to use "
-            "(default: serial)\n");
+    fprintf(f, "  --method METHOD                 computation method to use (default: serial)\n");
     fprintf(f,
             "  --width N                       width of the simulation "
             "(default: 512)\n");
@@ -99,17 +203,87 @@ static void show_help(FILE* f, const char* exec_name) {
     fprintf(f,
             "  --opencl-device N               opencl device index to use "
             "(default: 0)\n");
+    fprintf(f,
+            "  --opencl-memory MODE            opencl readback, copy, alloc-host or use-host "
+            "(default: copy)\n");
+    fprintf(f,
+            "  --opencl-local WIDTH[xHEIGHT]   work group size of the opencl-2d method "
+            "(default: auto-tuned)\n");
     fprintf(f,
             "  --opencl-kernel FILE            use a custom opencl kernel "
             "location\n");
+    fprintf(f,
+            "  --opencl-cache DIR              directory of the compiled kernel cache "
+            "(default: ~/.cache/sinoscope)\n");
+    fprintf(f, "  --no-opencl-cache               always compile the opencl kernel\n");
+    fprintf(f,
+            "  --schedule KIND[,CHUNK]         openmp schedule of the tiled method, static, "
+            "dynamic or guided (default: static)\n");
+    fprintf(f,
+            "  --omp-bind POLICY[,...]         thread binding of the openmp methods, false, true, primary, "
+            "close or spread, as OMP_PROC_BIND (default: runtime)\n");
+    fprintf(f,
+            "  --omp-places PLACES             places of the openmp threads, threads, cores, sockets or an "
+            "explicit list, as OMP_PLACES (default: runtime)\n");
+    fprintf(f,
+            "  --tile WIDTH[xHEIGHT]           tile size of the tiled and tasks methods "
+            "(default: 128x8)\n");
+    fprintf(f,
+            "  --reuse-tolerance RADIANS       phase drift under which the cached method keeps a series "
+            "(default: 0, nothing is reused while the frames animate)\n");
+    fprintf(f,
+            "  --format FORMAT                 buffer layout, rgb8 or rgba8, not every method renders "
+            "rgba8 (default: rgb8)\n");
+    fprintf(f,
+            "  --precision PRECISION           arithmetic of the series, default, double, float or native, "
+            "not every method follows it (default: default)\n");
     fprintf(f,
             "  --headless                      run the computation without "
             "graphical interface\n");
+    fprintf(f,
+            "  --target-fps FPS                lower the resolution, then the taylor degree, of the "
+            "headless and viewer frames to keep FPS (default: 0, full quality)\n");
     fprintf(f, "  --save FILE                     save a frame into a PNG image\n");
+    fprintf(f,
+            "  --serve PATH                    serve frames to local processes on the unix socket PATH, "
+            "from a shared memory ring\n");
+    fprintf(f, "  --serve-slots N                 frames of the ring, held by the clients until released "
+               "(default: 16)\n");
+    fprintf(f, "  --export PATTERN N              save N frames as PNG images named by the printf PATTERN, "
+               "`-` streams raw RGB frames to stdout\n");
+    fprintf(f, "  --export-batch K                frames rendered at once by the export (default: 8)\n");
+    fprintf(f, "  --export-jobs N                 PNG encoder threads (default: online CPUs)\n");
+    fprintf(f,
+            "  --instance WxH[:TAYLOR[:MAX]]   render this configuration with METHOD concurrently with the "
+            "other instances, repeatable (default: --taylor, max 200)\n");
+    fprintf(f, "  --driver-frames N               frames rendered by every instance (default: 100)\n");
     fprintf(f, "  --benchmarks N                  benchmark all implementations for N iterations\n");
+    fprintf(f,
+            "  --profile                       report min, median and p99 of the frame phases in the "
+            "benchmarks, opencl queues are created with profiling enabled\n");
     fprintf(f, "  --benchmark VARIANT N           benchmark VARIANT for N iterations\n");
     fprintf(f, "  --check VARIANT                 check VARIANT outputs\n");
+    fprintf(f,
+            "  --check-precision VARIANT [N]   error and frame time of every precision of VARIANT against "
+            "serial in double, over N frames, fails when host native strays from float (default: 10)\n");
+    fprintf(f, "  --sweep FILE                    benchmark every configuration, results written to FILE\n");
+    fprintf(f, "  --sweep-sizes WxH,...           sizes of the sweep (default: 256x256,512x512,1024x1024)\n");
+    fprintf(f, "  --sweep-taylor N,...            taylor degrees of the sweep (default: 3,6,12)\n");
+    fprintf(f, "  --sweep-threads N,...           openmp thread counts, 0 is the default (default: 1,0)\n");
+    fprintf(f, "  --sweep-schedules KIND,...      schedules of the tiled method (default: static,dynamic,guided)\n");
+    fprintf(f, "  --sweep-local WxH,...           work group sizes of opencl-2d (default: auto,8x1,16x4,32x8)\n");
+    fprintf(f, "  --sweep-methods VARIANT,...     methods of the sweep (default: all)\n");
+    fprintf(f, "  --sweep-warmup N                untimed frames per configuration (default: 2)\n");
+    fprintf(f, "  --sweep-trials N                timed frames per configuration (default: 7)\n");
+    fprintf(f, "  --sweep-format FORMAT           csv or json (default: csv)\n");
+    fprintf(f, "  --sweep-best FILE               save the fastest configuration of every size\n");
+    fprintf(f, "  --tuned FILE                    use the configuration saved by `--sweep-best`\n");
     fprintf(f, "  --help                          show this help\n");
+    fprintf(f, "\n");
+    fprintf(f, "Methods (METHOD or VARIANT):\n");
+    for (unsigned int i = 0; i < sinoscope_method_count; i++) {
+        fprintf(f, "  %-31s %s\n", sinoscope_methods[i].name, sinoscope_methods[i].variant);
+    }
 }
 
 static void fail_missing_argument(const char* exec_name, const char* opt) {
@@ -175,53 +349,85 @@ static unsigned int get_positive_integer_or_fail(const char* exec_name, const ch
     return value;
 }
 
-static void run_headless(sinoscope_t* sinoscope) {
-    if (headless_run(sinoscope) < 0) {
-        LOG_ERROR("failed to run headless");
-        exit(1);
-    }
-}
+/* every element of the comma separated OMP_PROC_BIND list, one per nesting level */
+static bool valid_proc_bind(const char* bind) {
+    static const char* const policies[] = {"false", "true", "master", "primary", "close", "spread"};
 
-static void run_benchmark_serial(unsigned int width, unsigned int height, unsigned int taylor,
-				 float max, unsigned int iterations) {
+    while (true) {
+        size_t length = strcspn(bind, ",");
+        bool found    = false;
 
-	sinoscope_t *s = sinoscope_create("serial", sinoscope_image_serial, width, height, max);
+        for (unsigned int i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+            found = found || (strlen(policies[i]) == length && strncmp(policies[i], bind, length) == 0);
+        }
 
-	if (!s) {
-		LOG_ERROR("failed to create sinoscope (serial)");
-		exit(1);
-	}
-	s->taylor = taylor;
-	if (sinoscope_benchmark(s, iterations) < 0) {
-        LOG_ERROR("failed to check ouputs");
-        exit(1);
+        if (!found) {
+            return false;
+        }
+
+        if (bind[length] == '\0') {
+            return true;
+        }
+
+        bind += length + 1;
     }
 }
 
-static void run_benchmark_mp(unsigned int width, unsigned int height, unsigned int taylor,
-			     float max, unsigned int iterations) {
+/*
+ * The openmp runtime reads OMP_PROC_BIND and OMP_PLACES once, when it is
+ * loaded, so the process runs again with them in its environment. Without
+ * /proc/self/exe the user is told to set them instead.
+ */
+static void apply_omp_placement(char* argv[], const char* bind, const char* places) {
+    const char* current_bind   = getenv("OMP_PROC_BIND");
+    const char* current_places = getenv("OMP_PLACES");
 
-		sinoscope_t *s = sinoscope_create("openmp", sinoscope_image_openmp, width, height, max);
+    bool same_bind   = bind == NULL || (current_bind != NULL && strcmp(current_bind, bind) == 0);
+    bool same_places = places == NULL || (current_places != NULL && strcmp(current_places, places) == 0);
 
-	if (!s) {
-		LOG_ERROR("failed to create sinoscope (openmp)");
-		exit(1);
-	}
+    if (same_bind && same_places) {
+        return;
+    }
 
-	s->taylor = taylor;
+#ifdef __linux__
+    if ((bind != NULL && setenv("OMP_PROC_BIND", bind, 1) < 0) ||
+        (places != NULL && setenv("OMP_PLACES", places, 1) < 0)) {
+        LOG_ERROR_ERRNO("setenv");
+        exit(1);
+    }
 
-	if (sinoscope_benchmark(s, iterations) < 0) {
-        LOG_ERROR("failed to check ouputs");
+    /* the new image starts with empty stdio buffers */
+    fflush(stdout);
+    execv("/proc/self/exe", argv);
+
+    LOG_ERROR_ERRNO("execv");
+#else
+    fprintf(stderr, "Run again with");
+    if (!same_bind) {
+        fprintf(stderr, " OMP_PROC_BIND=%s", bind);
+    }
+    if (!same_places) {
+        fprintf(stderr, " OMP_PLACES=%s", places);
+    }
+    fprintf(stderr, " in the environment\n");
+#endif
+    exit(1);
+}
+
+static void run_headless(sinoscope_t* sinoscope) {
+    if (headless_run(sinoscope) < 0) {
+        LOG_ERROR("failed to run headless");
         exit(1);
     }
 }
 
-static void run_benchmark_cl(sinoscope_opencl_t* opencl, unsigned int width, unsigned int height, unsigned int taylor,
-			     float max, unsigned int iterations) {
-	sinoscope_t *s = sinoscope_create("opencl", sinoscope_image_opencl, width, height, max);
+static void run_benchmark(const sinoscope_method_t* method, sinoscope_opencl_t* opencl, unsigned int width,
+                          unsigned int height, unsigned int taylor, float max, sinoscope_format_t format,
+                          unsigned int iterations) {
+	sinoscope_t *s = sinoscope_create(method->name, method->handler, width, height, max, format);
 
 	if (!s) {
-		LOG_ERROR("failed to create sinoscope (serial)");
+		LOG_ERROR("failed to create sinoscope (%s)", method->name);
 		exit(1);
 	}
 	s->taylor = taylor;
@@ -230,29 +436,86 @@ static void run_benchmark_cl(sinoscope_opencl_t* opencl, unsigned int width, uns
         LOG_ERROR("failed to check ouputs");
         exit(1);
     }
+
+	sinoscope_destroy(s);
 }
 
 static void run_benchmarks(sinoscope_opencl_t* opencl, unsigned int width, unsigned int height, unsigned int taylor,
-                          float max, unsigned int iterations) {
-    if (sinoscope_benchmarks(width, height, taylor, max, opencl, iterations) < 0) {
+                          float max, sinoscope_format_t format, unsigned int iterations) {
+    if (sinoscope_benchmarks(width, height, taylor, max, format, opencl, iterations) < 0) {
         LOG_ERROR("failed to check ouputs");
         exit(1);
     }
 }
 
-static void run_check_mp(unsigned int width, unsigned int height, unsigned int taylor,
-			 float max) {
-    if (sinoscope_check(width, height, taylor, max, NULL) < 0) {
+static void run_check(const sinoscope_method_t* method, sinoscope_opencl_t* opencl, unsigned int width,
+                      unsigned int height, unsigned int taylor, float max, sinoscope_format_t format) {
+    if (sinoscope_check_handler(method->name, method->handler, width, height, taylor, max, format, opencl,
+                                method->max_diff) < 0) {
         LOG_ERROR("failed to check ouputs");
         exit(1);
     }
 }
 
+static void parse_instance_or_fail(const char* exec_name, const char* arg_name, const char* arg,
+                                   sinoscope_driver_instance_t* instance) {
+    char* x = strchr(arg, 'x');
+    if (x == NULL) {
+        fail_argument_parsing(exec_name, arg_name, arg);
+    }
+
+    instance->width  = get_strictly_positive_integer_or_fail(exec_name, arg_name, arg);
+    instance->height = get_strictly_positive_integer_or_fail(exec_name, arg_name, x + 1);
 
-static void run_check_cl(sinoscope_opencl_t* opencl, unsigned int width, unsigned int height, unsigned int taylor,
-			 float max) {
-    if (sinoscope_check(width, height, taylor, max, opencl) < 0) {
-        LOG_ERROR("failed to check ouputs");
+    /* zero is resolved to `--taylor` and the default max once every option is parsed */
+    instance->taylor = 0;
+    instance->max    = 0;
+
+    char* colon = strchr(x, ':');
+    if (colon == NULL) {
+        return;
+    }
+
+    instance->taylor = get_strictly_positive_integer_or_fail(exec_name, arg_name, colon + 1);
+
+    colon = strchr(colon + 1, ':');
+    if (colon == NULL) {
+        return;
+    }
+
+    char* end;
+    instance->max = strtof(colon + 1, &end);
+    if (end == colon + 1 || *end != '\0' || instance->max <= 0) {
+        fail_argument_parsing(exec_name, arg_name, arg);
+    }
+}
+
+static void fail_format(const sinoscope_method_t* method, sinoscope_format_t format) {
+    if (!sinoscope_method_supports(method, format)) {
+        fprintf(stderr, "Method `%s` does not render the %s format\n", method->name, sinoscope_format_name(format));
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void fail_precision(const sinoscope_method_t* method) {
+    if (!sinoscope_method_renders(method, sinoscope_precision)) {
+        fprintf(stderr, "Method `%s` does not render the %s precision\n", method->name,
+                sinoscope_precision_name(sinoscope_precision));
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void run_check_precision(const sinoscope_method_t* method, sinoscope_opencl_t* opencl, unsigned int width,
+                                unsigned int height, unsigned int taylor, float max, unsigned int frames) {
+    if (sinoscope_check_precision(method, width, height, taylor, max, opencl, frames) < 0) {
+        LOG_ERROR("failed to check precisions");
+        exit(1);
+    }
+}
+
+static void run_server(sinoscope_t* sinoscope, const char* path, unsigned int slots) {
+    if (server_run(sinoscope, path, slots) < 0) {
+        LOG_ERROR("failed to run server");
         exit(1);
     }
 }
@@ -272,7 +535,8 @@ static void run_viewer(sinoscope_t* sinoscope) {
 }
 
 static sinoscope_opencl_t* configure_opencl(unsigned int platform, unsigned int device, sinoscope_opencl_t* opencl,
-                                            unsigned int width, unsigned int height) {
+                                            unsigned int width, unsigned int height,
+                                            sinoscope_opencl_memory_t memory, const size_t* local_size) {
     cl_device_id device_id;
     if (opencl_get_device_id(platform, device, &device_id) < 0) {
         LOG_ERROR("failed to get device ID");
@@ -284,6 +548,11 @@ static sinoscope_opencl_t* configure_opencl(unsigned int platform, unsigned int
         goto fail_exit;
     }
 
+    opencl->memory        = memory;
+    opencl->local_size[0] = local_size[0];
+    opencl->local_size[1] = local_size[1];
+    opencl->precision     = sinoscope_precision;
+
     if (sinoscope_opencl_init(opencl, device_id, width, height) < 0) {
         LOG_ERROR("failed to initialize OpenCL context");
         goto fail_exit;
@@ -304,25 +573,55 @@ int main(int argc, char* argv[]) {
 #endif
 
     char* exec_name        = argv[0];
-    bool use_method_serial = false;
-    bool use_method_openmp = false;
-    bool use_method_opencl = false;
+    const sinoscope_method_t* method = NULL;
     int use_method_count   = 0;
     bool do_run_headless   = false;
     bool do_benchmarks      = false;
     bool do_save_image     = false;
     char *check            = NULL;
+    char *check_precision  = NULL;
+    unsigned int precision_frames = 10;
     char *benchmark        = NULL;
+    char *sweep_path       = NULL;
+    char *tuned_path       = NULL;
+
+    sinoscope_sweep_t sweep;
+    sinoscope_sweep_defaults(&sweep);
 
     char* save_filename = NULL;
+    char* omp_bind   = NULL;
+    char* omp_places = NULL;
+
+    char* serve_path         = NULL;
+    unsigned int serve_slots = 16;
+    float target_fps    = 0;
+
+    sinoscope_format_t format = SINOSCOPE_FORMAT_RGB8;
+
+    char* export_pattern      = NULL;
+    unsigned int export_count = 0;
+    unsigned int export_batch = 8;
+    unsigned int export_jobs  = sysconf(_SC_NPROCESSORS_ONLN);
+
+    sinoscope_driver_instance_t instances[SINOSCOPE_DRIVER_MAX];
+    unsigned int instance_count = 0;
+    unsigned int driver_frames  = 100;
 
     unsigned int width      = 512;
     unsigned int height     = 512;
     unsigned int taylor     = 6;
     unsigned int iterations = 0;
 
+    char schedule_kind[16]        = "";
+    char* schedule                = NULL;
+    unsigned int schedule_chunk   = 0;
+    unsigned int tile_width       = 0;
+    unsigned int tile_height      = 0;
+
     unsigned int opencl_platform_index = 0;
     unsigned int opencl_device_index   = 0;
+    sinoscope_opencl_memory_t opencl_memory = SINOSCOPE_OPENCL_MEMORY_COPY;
+    size_t opencl_local_size[2]             = {0, 0};
 
     for (int i = 1; i < argc; i++) {
         if (strcmp("--method", argv[i]) == 0) {
@@ -330,18 +629,11 @@ int main(int argc, char* argv[]) {
                 fail_missing_argument(exec_name, argv[i]);
             }
 
-            if (strcmp("serial", argv[i + 1]) == 0) {
-                use_method_serial = true;
-                use_method_count++;
-            } else if (strcmp("openmp", argv[i + 1]) == 0) {
-                use_method_openmp = true;
-                use_method_count++;
-            } else if (strcmp("opencl", argv[i + 1]) == 0) {
-                use_method_opencl = true;
-                use_method_count++;
-            } else {
+            method = sinoscope_find_method(argv[i + 1]);
+            if (method == NULL) {
                 fail_unknown_method(exec_name, argv[i + 1]);
             }
+            use_method_count++;
 
             i++;
         } else if (strcmp("--width", argv[i]) == 0) {
@@ -379,6 +671,30 @@ int main(int argc, char* argv[]) {
 
             opencl_device_index = get_positive_integer_or_fail(exec_name, argv[i], argv[i + 1]);
             i++;
+        } else if (strcmp("--opencl-memory", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            if (strcmp("copy", argv[i + 1]) == 0) {
+                opencl_memory = SINOSCOPE_OPENCL_MEMORY_COPY;
+            } else if (strcmp("alloc-host", argv[i + 1]) == 0) {
+                opencl_memory = SINOSCOPE_OPENCL_MEMORY_ALLOC_HOST;
+            } else if (strcmp("use-host", argv[i + 1]) == 0) {
+                opencl_memory = SINOSCOPE_OPENCL_MEMORY_USE_HOST;
+            } else {
+                fail_argument_parsing(exec_name, argv[i], argv[i + 1]);
+            }
+            i++;
+        } else if (strcmp("--opencl-local", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            opencl_local_size[0] = get_strictly_positive_integer_or_fail(exec_name, argv[i], argv[i + 1]);
+            char* x              = strchr(argv[i + 1], 'x');
+            opencl_local_size[1] = (x != NULL) ? get_strictly_positive_integer_or_fail(exec_name, argv[i], x + 1) : 1;
+            i++;
         } else if (strcmp("--opencl-kernel", argv[i]) == 0) {
             if (i >= argc - 1) {
                 fail_missing_argument(exec_name, argv[i]);
@@ -386,8 +702,106 @@ int main(int argc, char* argv[]) {
 
             opencl_kernel_path = argv[i + 1];
             i++;
+        } else if (strcmp("--opencl-cache", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            opencl_cache_dir = argv[i + 1];
+            i++;
+        } else if (strcmp("--no-opencl-cache", argv[i]) == 0) {
+            opencl_cache_enabled = false;
+        } else if (strcmp("--precision", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            if (sinoscope_parse_precision(argv[i + 1], &sinoscope_precision) < 0) {
+                fail_argument_parsing(exec_name, argv[i], argv[i + 1]);
+            }
+            i++;
+        } else if (strcmp("--profile", argv[i]) == 0) {
+            sinoscope_profile = true;
+        } else if (strcmp("--omp-bind", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            if (!valid_proc_bind(argv[i + 1])) {
+                fail_argument_parsing(exec_name, argv[i], argv[i + 1]);
+            }
+
+            omp_bind = argv[i + 1];
+            i++;
+        } else if (strcmp("--omp-places", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            omp_places = argv[i + 1];
+            i++;
+        } else if (strcmp("--schedule", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            /* argv is kept intact, the placement options run it again */
+            const char* chunk = strchr(argv[i + 1], ',');
+            size_t length     = chunk != NULL ? (size_t)(chunk - argv[i + 1]) : strlen(argv[i + 1]);
+            if (length >= sizeof(schedule_kind)) {
+                fail_argument_parsing(exec_name, argv[i], argv[i + 1]);
+            }
+
+            memcpy(schedule_kind, argv[i + 1], length);
+            schedule_kind[length] = '\0';
+            schedule              = schedule_kind;
+
+            if (chunk != NULL) {
+                schedule_chunk = get_strictly_positive_integer_or_fail(exec_name, argv[i], chunk + 1);
+            }
+            i++;
+        } else if (strcmp("--tile", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            tile_width  = get_strictly_positive_integer_or_fail(exec_name, argv[i], argv[i + 1]);
+            char* x     = strchr(argv[i + 1], 'x');
+            tile_height = (x != NULL) ? get_strictly_positive_integer_or_fail(exec_name, argv[i], x + 1) : tile_width;
+            i++;
+        } else if (strcmp("--reuse-tolerance", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            char* end;
+            sinoscope_reuse_tolerance = strtof(argv[i + 1], &end);
+            if (end == argv[i + 1] || *end != '\0' || sinoscope_reuse_tolerance < 0) {
+                fail_argument_parsing(exec_name, argv[i], argv[i + 1]);
+            }
+            i++;
+        } else if (strcmp("--format", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            if (sinoscope_parse_format(argv[i + 1], &format) < 0) {
+                fail_argument_parsing(exec_name, argv[i], argv[i + 1]);
+            }
+            i++;
         } else if (strcmp("--headless", argv[i]) == 0) {
             do_run_headless = true;
+        } else if (strcmp("--target-fps", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            char* end;
+            target_fps = strtof(argv[i + 1], &end);
+            if (end == argv[i + 1] || *end != '\0' || target_fps < 0) {
+                fail_argument_parsing(exec_name, argv[i], argv[i + 1]);
+            }
+            i++;
         } else if (strcmp("--save", argv[i]) == 0) {
             if (i >= argc - 1) {
                 fail_missing_argument(exec_name, argv[i]);
@@ -396,6 +810,62 @@ int main(int argc, char* argv[]) {
             do_save_image = true;
             save_filename = argv[i + 1];
             i++;
+        } else if (strcmp("--serve", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            serve_path = argv[i + 1];
+            i++;
+        } else if (strcmp("--serve-slots", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            serve_slots = get_strictly_positive_integer_or_fail(exec_name, argv[i], argv[i + 1]);
+            i++;
+        } else if (strcmp("--export", argv[i]) == 0) {
+            if (i >= argc - 2) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            export_pattern = argv[i + 1];
+            export_count   = get_strictly_positive_integer_or_fail(exec_name, argv[i], argv[i + 2]);
+            i += 2;
+        } else if (strcmp("--export-batch", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            export_batch = get_strictly_positive_integer_or_fail(exec_name, argv[i], argv[i + 1]);
+            i++;
+        } else if (strcmp("--export-jobs", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            export_jobs = get_strictly_positive_integer_or_fail(exec_name, argv[i], argv[i + 1]);
+            i++;
+        } else if (strcmp("--instance", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            if (instance_count == SINOSCOPE_DRIVER_MAX) {
+                fprintf(stderr, "%s: at most %d options `--instance` can be specified\n", exec_name,
+                        SINOSCOPE_DRIVER_MAX);
+                exit(1);
+            }
+
+            parse_instance_or_fail(exec_name, argv[i], argv[i + 1], &instances[instance_count++]);
+            i++;
+        } else if (strcmp("--driver-frames", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            driver_frames = get_strictly_positive_integer_or_fail(exec_name, argv[i], argv[i + 1]);
+            i++;
         } else if (strcmp("--benchmarks", argv[i]) == 0) {
             if (i >= argc - 1) {
                 fail_missing_argument(exec_name, argv[i]);
@@ -422,6 +892,42 @@ int main(int argc, char* argv[]) {
 		}
 		check = argv[i + 1];
 		i++;
+        } else if (strcmp("--check-precision", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            check_precision = argv[i + 1];
+            i++;
+
+            /* the frame count is optional */
+            if (i < argc - 1 && argv[i + 1][0] != '-') {
+                precision_frames = get_strictly_positive_integer_or_fail(exec_name, "--check-precision", argv[i + 1]);
+                i++;
+            }
+        } else if (strcmp("--sweep", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            sweep_path = argv[i + 1];
+            i++;
+        } else if (strncmp("--sweep-", argv[i], strlen("--sweep-")) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            if (sinoscope_sweep_option(&sweep, argv[i] + strlen("--sweep-"), argv[i + 1]) < 0) {
+                fail_argument_parsing(exec_name, argv[i], argv[i + 1]);
+            }
+            i++;
+        } else if (strcmp("--tuned", argv[i]) == 0) {
+            if (i >= argc - 1) {
+                fail_missing_argument(exec_name, argv[i]);
+            }
+
+            tuned_path = argv[i + 1];
+            i++;
         } else if (strcmp("--help", argv[i]) == 0) {
             show_help(stdout, exec_name);
             exit(0);
@@ -430,74 +936,199 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (omp_bind != NULL || omp_places != NULL) {
+        apply_omp_placement(argv, omp_bind, omp_places);
+        sinoscope_openmp_print_placement();
+    }
+
+    /* raw frames keep the real stdout, everything printed goes to stderr instead */
+    FILE* export_raw = NULL;
+
+    if (export_pattern != NULL && strcmp(export_pattern, "-") == 0) {
+        int raw_fd = dup(STDOUT_FILENO);
+        if (raw_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            LOG_ERROR_ERRNO("dup");
+            exit(1);
+        }
+
+        export_raw = fdopen(raw_fd, "wb");
+        if (export_raw == NULL) {
+            LOG_ERROR_ERRNO("fdopen");
+            exit(1);
+        }
+    }
+
     sinoscope_t* sinoscope = NULL;
     sinoscope_opencl_t sinoscope_opencl;
     sinoscope_opencl_t* sinoscope_opencl_ptr = NULL;
 
+    /* explicit options win over the tuned configuration, `schedule` may point into it */
+    sinoscope_tuning_t tuning;
+
+    if (tuned_path != NULL) {
+        int found = sinoscope_sweep_load(tuned_path, width, height, taylor, &tuning);
+
+        if (found < 0) {
+            LOG_ERROR("failed to load tuned configuration");
+            exit(1);
+        }
+
+        if (found) {
+            printf("Using tuned configuration: %s\n", tuning.method);
+
+            if (use_method_count == 0) {
+                method = sinoscope_find_method(tuning.method);
+                use_method_count = (method != NULL) ? 1 : 0;
+            }
+
+            if (tuning.threads > 0) {
+                sinoscope_openmp_set_threads(tuning.threads);
+            }
+
+            if (schedule == NULL && tuning.schedule[0] != '\0') {
+                schedule = tuning.schedule;
+            }
+
+            if (opencl_local_size[0] == 0) {
+                opencl_local_size[0] = tuning.local_size[0];
+                opencl_local_size[1] = tuning.local_size[1];
+            }
+        }
+    }
+
+    if (sinoscope_openmp_configure(schedule, schedule_chunk, tile_width, tile_height) < 0) {
+        LOG_ERROR("failed to configure openmp");
+        exit(1);
+    }
+
+    if (sweep_path != NULL) {
+        cl_device_id device_id;
+        bool has_opencl = opencl_get_device_id(opencl_platform_index, opencl_device_index, &device_id) == 0 &&
+                          opencl_print_device_info(device_id) == 0;
+
+        if (!has_opencl) {
+            printf("Disabling OpenCL support\n");
+        }
+
+        if (sinoscope_sweep(&sweep, sweep_path, has_opencl ? &device_id : NULL, opencl_memory, 200.0) < 0) {
+            LOG_ERROR("failed to run sweep");
+            exit(1);
+        }
+
+        goto done;
+    }
+
     if (do_benchmarks) {
 	    sinoscope_opencl_ptr =
-        configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl, width, height);
+        configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl, width, height,
+				     opencl_memory, opencl_local_size);
 
-        run_benchmarks(sinoscope_opencl_ptr, width, height, taylor, 200.0, iterations);
+        run_benchmarks(sinoscope_opencl_ptr, width, height, taylor, 200.0, format, iterations);
         goto done;
     }
 
     if (benchmark)  {
+	    const sinoscope_method_t* benchmark_method = sinoscope_find_method(benchmark);
 
-	    if (0 == strcmp(benchmark, "serial")) {
-		    run_benchmark_serial(width, height, taylor, 200.0, iterations);
-	    } else if (0 == strcmp(benchmark, "mp")) {
-		    run_benchmark_mp(width, height, taylor, 200.0, iterations);
-	    } else if(0 == strcmp(benchmark, "cl")) {
-		    	    sinoscope_opencl_ptr =
-		    configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl, width, height);
-
-			    run_benchmark_cl(sinoscope_opencl_ptr, width, height, taylor, 200.0, iterations);
-	    } else {
-		    fprintf(stderr, "Invalid benchmark: %s\n", check);
+	    if (benchmark_method == NULL) {
+		    fprintf(stderr, "Invalid benchmark: %s\n", benchmark);
 		    exit(EXIT_FAILURE);
 	    }
 
+	    fail_format(benchmark_method, format);
+	    fail_precision(benchmark_method);
+
+	    if (benchmark_method->opencl) {
+		    sinoscope_opencl_ptr =
+		    configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl, width, height,
+				     opencl_memory, opencl_local_size);
+	    }
+
+	    run_benchmark(benchmark_method, sinoscope_opencl_ptr, width, height, taylor, 200.0, format, iterations);
+
 	    goto done;
     }
 
     if (check) {
+	    const sinoscope_method_t* check_method = sinoscope_find_method(check);
 
-	    if (0 == strcmp(check, "mp")) {
-		    run_check_mp(width, height, taylor, 200.0);
-	    } else if(0 == strcmp(check, "cl")) {
-		    	    sinoscope_opencl_ptr =
-		    configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl, width, height);
-
-		    run_check_cl(sinoscope_opencl_ptr, width, height, taylor, 200.0);
-	    } else {
+	    if (check_method == NULL) {
 		    fprintf(stderr, "Invalid check: %s\n", check);
 		    exit(EXIT_FAILURE);
 	    }
 
+	    fail_format(check_method, format);
+	    fail_precision(check_method);
+
+	    if (check_method->opencl) {
+		    sinoscope_opencl_ptr =
+		    configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl, width, height,
+				     opencl_memory, opencl_local_size);
+	    }
+
+	    run_check(check_method, sinoscope_opencl_ptr, width, height, taylor, 200.0, format);
+
 	    goto done;
     }
 
+    if (check_precision) {
+        const sinoscope_method_t* check_method = sinoscope_find_method(check_precision);
+
+        if (check_method == NULL) {
+            fprintf(stderr, "Invalid check: %s\n", check_precision);
+            exit(EXIT_FAILURE);
+        }
+
+        /* every precision gets its own context, this one only picks the device */
+        if (check_method->opencl) {
+            sinoscope_opencl_ptr = configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl,
+                                                    width, height, opencl_memory, opencl_local_size);
+        }
+
+        run_check_precision(check_method, sinoscope_opencl_ptr, width, height, taylor, 200.0, precision_frames);
+
+        goto done;
+    }
+
     if (use_method_count == 0) {
-        use_method_serial = true;
+        method = sinoscope_find_method("serial");
     } else if (use_method_count > 1) {
         fail_multiple_method(exec_name);
     }
 
-    if (use_method_serial) {
-        sinoscope = sinoscope_create("serial", sinoscope_image_serial, width, height, 200.0);
-    } else if (use_method_openmp) {
-        sinoscope = sinoscope_create("openmp", sinoscope_image_openmp, width, height, 200.0);
-    } else if (use_method_opencl) {
-	    sinoscope_opencl_ptr =
-		    configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl, width, height);
+    fail_format(method, format);
+    fail_precision(method);
 
-        sinoscope = sinoscope_create("opencl", sinoscope_image_opencl, width, height, 200.0);
-    } else {
-        LOG_ERROR("no method defined");
-        exit(1);
+    if (instance_count > 0) {
+        for (unsigned int i = 0; i < instance_count; i++) {
+            instances[i].taylor = (instances[i].taylor == 0) ? taylor : instances[i].taylor;
+            instances[i].max    = (instances[i].max == 0) ? 200.0 : instances[i].max;
+        }
+
+        /* the root context only holds the program, its own buffers have the size of the first instance */
+        if (method->opencl) {
+            sinoscope_opencl_ptr =
+                configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl, instances[0].width,
+                                 instances[0].height, opencl_memory, opencl_local_size);
+        }
+
+        if (sinoscope_driver(method->name, instances, instance_count, driver_frames, format, sinoscope_opencl_ptr) <
+            0) {
+            LOG_ERROR("failed to run driver");
+            exit(1);
+        }
+
+        goto done;
+    }
+
+    if (method->opencl) {
+	    sinoscope_opencl_ptr =
+		    configure_opencl(opencl_platform_index, opencl_device_index, &sinoscope_opencl, width, height,
+				     opencl_memory, opencl_local_size);
     }
 
+    sinoscope = sinoscope_create(method->name, method->handler, width, height, 200.0, format);
+
     if (sinoscope == NULL) {
         LOG_ERROR("failed to create sinoscope");
         exit(1);
@@ -506,11 +1137,22 @@ int main(int argc, char* argv[]) {
     sinoscope->opencl = sinoscope_opencl_ptr;
     sinoscope->taylor = taylor;
 
+    sinoscope->adaptive.target_fps = target_fps;
+
     if (getenv("DISPLAY") == NULL) {
         printf("DISPLAY environment variable not set, forcing headless mode\n");
         do_run_headless = true;
     }
 
+    if (export_pattern != NULL) {
+        if (sinoscope_export(sinoscope, export_pattern, export_raw, export_count, export_batch, export_jobs) < 0) {
+            LOG_ERROR("failed to export frames");
+            exit(1);
+        }
+
+        goto done;
+    }
+
     if (do_save_image) {
         if (sinoscope_save_image(sinoscope, save_filename) < 0) {
             LOG_ERROR("failed to save image");
@@ -520,6 +1162,11 @@ int main(int argc, char* argv[]) {
         goto done;
     }
 
+    if (serve_path != NULL) {
+        run_server(sinoscope, serve_path, serve_slots);
+        goto done;
+    }
+
     if (do_run_headless) {
         run_headless(sinoscope);
     } else {
@@ -527,6 +1174,10 @@ int main(int argc, char* argv[]) {
     }
 
 done:
+    if (export_raw != NULL) {
+        fclose(export_raw);
+    }
+
     if (sinoscope_opencl_ptr != NULL) {
         sinoscope_opencl_cleanup(sinoscope_opencl_ptr);
     }
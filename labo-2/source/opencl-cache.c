@@ -0,0 +1,330 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "opencl-cache.h"
+#include "opencl.h"
+
+/* 64 bits FNV-1a, the same key on every run unlike pointers or timestamps */
+static const uint64_t HASH_OFFSET = 0xcbf29ce484222325ULL;
+static const uint64_t HASH_PRIME  = 0x100000001b3ULL;
+
+char* opencl_cache_dir    = NULL;
+bool opencl_cache_enabled = true;
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t len) {
+    const unsigned char* bytes = data;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= HASH_PRIME;
+    }
+
+    return hash;
+}
+
+/* the terminator is hashed too so that fields cannot run into each other */
+static uint64_t hash_string(uint64_t hash, const char* str) {
+    return hash_bytes(hash, str, strlen(str) + 1);
+}
+
+static int hash_device_info(uint64_t* hash, cl_device_id device_id, cl_device_info param) {
+    size_t len;
+    cl_int status = clGetDeviceInfo(device_id, param, 0, NULL, &len);
+    if (status != CL_SUCCESS) {
+        LOG_ERROR("clGetDeviceInfo (%d)", status);
+        goto fail_exit;
+    }
+
+    char* value = malloc(len);
+    if (value == NULL) {
+        LOG_ERROR_ERRNO("malloc");
+        goto fail_exit;
+    }
+
+    status = clGetDeviceInfo(device_id, param, len, value, NULL);
+    if (status != CL_SUCCESS) {
+        LOG_ERROR("clGetDeviceInfo (%d)", status);
+        goto fail_free_value;
+    }
+
+    *hash = hash_bytes(*hash, value, len);
+    free(value);
+
+    return 0;
+
+fail_free_value:
+    free(value);
+fail_exit:
+    return -1;
+}
+
+/* a missing file is not an error for the cache, nothing is logged */
+static int read_file(const char* path, unsigned char** data, size_t* len) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        goto fail_exit;
+    }
+
+    if (fseek(file, 0, SEEK_END) < 0) {
+        goto fail_close_file;
+    }
+
+    long size = ftell(file);
+    if (size <= 0) {
+        goto fail_close_file;
+    }
+    rewind(file);
+
+    *data = malloc(size);
+    if (*data == NULL) {
+        LOG_ERROR_ERRNO("malloc");
+        goto fail_close_file;
+    }
+
+    if (fread(*data, 1, size, file) != (size_t)size) {
+        goto fail_free_data;
+    }
+
+    *len = size;
+    fclose(file);
+
+    return 0;
+
+fail_free_data:
+    free(*data);
+fail_close_file:
+    fclose(file);
+fail_exit:
+    *data = NULL;
+    return -1;
+}
+
+static int make_directories(char* path) {
+    for (char* cursor = path + 1;; cursor++) {
+        if (*cursor != '/' && *cursor != '\0') {
+            continue;
+        }
+
+        char separator = *cursor;
+        *cursor        = '\0';
+        int ret        = mkdir(path, 0755);
+        *cursor        = separator;
+
+        if (ret < 0 && errno != EEXIST) {
+            LOG_ERROR_ERRNO("mkdir");
+            return -1;
+        }
+
+        if (separator == '\0') {
+            return 0;
+        }
+    }
+}
+
+static int cache_path(char* path, size_t size, cl_device_id device_id, const char* source, size_t len,
+                      const char* options, const char* const* dependencies) {
+    char dir[PATH_MAX];
+    int written;
+
+    if (opencl_cache_dir != NULL) {
+        written = snprintf(dir, sizeof(dir), "%s", opencl_cache_dir);
+    } else if (getenv("XDG_CACHE_HOME") != NULL) {
+        written = snprintf(dir, sizeof(dir), "%s/sinoscope", getenv("XDG_CACHE_HOME"));
+    } else if (getenv("HOME") != NULL) {
+        written = snprintf(dir, sizeof(dir), "%s/.cache/sinoscope", getenv("HOME"));
+    } else {
+        goto fail_exit;
+    }
+
+    /* a truncated path would name another directory, the program is simply not cached */
+    if (written < 0 || (size_t)written >= sizeof(dir)) {
+        LOG_ERROR("cache directory is too long");
+        goto fail_exit;
+    }
+
+    uint64_t hash = HASH_OFFSET;
+    if (hash_device_info(&hash, device_id, CL_DEVICE_NAME) < 0 ||
+        hash_device_info(&hash, device_id, CL_DRIVER_VERSION) < 0) {
+        goto fail_exit;
+    }
+
+    hash = hash_string(hash, options);
+    hash = hash_bytes(hash, source, len);
+
+    for (const char* const* dependency = dependencies; dependency && *dependency; dependency++) {
+        unsigned char* data;
+        size_t data_len;
+
+        if (read_file(*dependency, &data, &data_len) < 0) {
+            LOG_ERROR("failed to read `%s`", *dependency);
+            goto fail_exit;
+        }
+
+        hash = hash_bytes(hash, data, data_len);
+        free(data);
+    }
+
+    if (make_directories(dir) < 0) {
+        goto fail_exit;
+    }
+
+    written = snprintf(path, size, "%s/%016llx.bin", dir, (unsigned long long)hash);
+    if (written < 0 || (size_t)written >= size) {
+        LOG_ERROR("cache path is too long");
+        goto fail_exit;
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+static int load_binary(cl_context context, cl_device_id device_id, const char* path, const char* options,
+                       cl_program* program) {
+    unsigned char* binary;
+    size_t len;
+
+    if (read_file(path, &binary, &len) < 0) {
+        goto fail_exit;
+    }
+
+    cl_int binary_status;
+    cl_int status;
+    *program = clCreateProgramWithBinary(context, 1, &device_id, &len, (const unsigned char**)&binary,
+                                         &binary_status, &status);
+    free(binary);
+
+    if (status != CL_SUCCESS || binary_status != CL_SUCCESS) {
+        goto fail_exit;
+    }
+
+    /* binaries from another driver build are rejected here, the source is built again */
+    status = clBuildProgram(*program, 1, &device_id, options, NULL, NULL);
+    if (status != CL_SUCCESS) {
+        goto fail_release_program;
+    }
+
+    return 0;
+
+fail_release_program:
+    clReleaseProgram(*program);
+fail_exit:
+    *program = NULL;
+    return -1;
+}
+
+/* written under a temporary name first, concurrent runs never read a partial binary */
+static int save_binary(cl_program program, const char* path) {
+    size_t len;
+    cl_int status = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(len), &len, NULL);
+    if (status != CL_SUCCESS) {
+        LOG_ERROR("clGetProgramInfo(CL_PROGRAM_BINARY_SIZES) (%d)", status);
+        goto fail_exit;
+    }
+
+    unsigned char* binary = malloc(len);
+    if (binary == NULL) {
+        LOG_ERROR_ERRNO("malloc");
+        goto fail_exit;
+    }
+
+    status = clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binary), &binary, NULL);
+    if (status != CL_SUCCESS) {
+        LOG_ERROR("clGetProgramInfo(CL_PROGRAM_BINARIES) (%d)", status);
+        goto fail_free_binary;
+    }
+
+    char temporary[PATH_MAX];
+    int written = snprintf(temporary, sizeof(temporary), "%s.%d", path, (int)getpid());
+    if (written < 0 || (size_t)written >= sizeof(temporary)) {
+        LOG_ERROR("cache path is too long");
+        goto fail_free_binary;
+    }
+
+    FILE* file = fopen(temporary, "wb");
+    if (file == NULL) {
+        LOG_ERROR_ERRNO("fopen");
+        goto fail_free_binary;
+    }
+
+    if (fwrite(binary, 1, len, file) != len) {
+        LOG_ERROR_ERRNO("fwrite");
+        fclose(file);
+        goto fail_remove_temporary;
+    }
+
+    if (fclose(file) != 0) {
+        LOG_ERROR_ERRNO("fclose");
+        goto fail_remove_temporary;
+    }
+
+    if (rename(temporary, path) < 0) {
+        LOG_ERROR_ERRNO("rename");
+        goto fail_remove_temporary;
+    }
+
+    free(binary);
+
+    return 0;
+
+fail_remove_temporary:
+    unlink(temporary);
+fail_free_binary:
+    free(binary);
+fail_exit:
+    return -1;
+}
+
+static int build_source(cl_context context, cl_device_id device_id, const char* source, size_t len,
+                        const char* options, cl_program* program) {
+    cl_int status;
+    *program = clCreateProgramWithSource(context, 1, &source, &len, &status);
+    if (status != CL_SUCCESS) {
+        LOG_ERROR("clCreateProgramWithSource (%d)", status);
+        goto fail_exit;
+    }
+
+    status = clBuildProgram(*program, 1, &device_id, options, NULL, NULL);
+    opencl_print_build_log(*program, device_id);
+    if (status != CL_SUCCESS) {
+        LOG_ERROR("clBuildProgram (%d)", status);
+        goto fail_release_program;
+    }
+
+    return 0;
+
+fail_release_program:
+    clReleaseProgram(*program);
+fail_exit:
+    *program = NULL;
+    return -1;
+}
+
+int opencl_cache_build_program(cl_context context, cl_device_id device_id, const char* source, size_t len,
+                               const char* options, const char* const* dependencies, cl_program* program) {
+    char path[PATH_MAX];
+    bool cached = opencl_cache_enabled &&
+                  cache_path(path, sizeof(path), device_id, source, len, options, dependencies) == 0;
+
+    if (cached && load_binary(context, device_id, path, options, program) == 0) {
+        printf("OpenCL Program Cache: loaded `%s`\n", path);
+        return 0;
+    }
+
+    if (build_source(context, device_id, source, len, options, program) < 0) {
+        return -1;
+    }
+
+    /* the program is usable even if the binary cannot be saved */
+    if (cached && save_binary(*program, path) == 0) {
+        printf("OpenCL Program Cache: saved `%s`\n", path);
+    }
+
+    return 0;
+}
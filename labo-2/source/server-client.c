@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "server.h"
+
+/*
+ * Minimal client of the frame server, run by the `check` target: it
+ * requests one frame, checks the reply and the slot it names, releases it,
+ * then checks that a message longer than a request gets it disconnected.
+ */
+
+/* the server may still be compiling its kernels when the client starts */
+static const unsigned int CONNECT_ATTEMPTS = 200;
+static const long CONNECT_DELAY_NS         = 50000000;
+
+static int connect_server(const char* path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        LOG_ERROR("socket path `%s` is too long", path);
+        goto fail_exit;
+    }
+
+    strcpy(address.sun_path, path);
+
+    for (unsigned int attempt = 0; attempt < CONNECT_ATTEMPTS; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            LOG_ERROR_ERRNO("socket");
+            goto fail_exit;
+        }
+
+        if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+            return fd;
+        }
+
+        close(fd);
+
+        if (errno != ENOENT && errno != ECONNREFUSED) {
+            LOG_ERROR_ERRNO("connect");
+            goto fail_exit;
+        }
+
+        struct timespec delay = {.tv_sec = 0, .tv_nsec = CONNECT_DELAY_NS};
+        nanosleep(&delay, NULL);
+    }
+
+    LOG_ERROR("no server listening on `%s`", path);
+fail_exit:
+    return -1;
+}
+
+static int receive_hello(int fd, server_hello_t* hello, int* memfd) {
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct iovec iov      = {.iov_base = hello, .iov_len = sizeof(*hello)};
+    struct msghdr message = {
+        .msg_iov        = &iov,
+        .msg_iovlen     = 1,
+        .msg_control    = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+
+    if (recvmsg(fd, &message, MSG_CMSG_CLOEXEC) != sizeof(*hello)) {
+        LOG_ERROR_ERRNO("recvmsg");
+        return -1;
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        LOG_ERROR("hello without the frame ring");
+        return -1;
+    }
+
+    memcpy(memfd, CMSG_DATA(cmsg), sizeof(int));
+
+    if (hello->version != SERVER_PROTOCOL_VERSION) {
+        LOG_ERROR("protocol version %u, expected %u", hello->version, SERVER_PROTOCOL_VERSION);
+        close(*memfd);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int request_frame(int fd, const server_hello_t* hello, const unsigned char* ring) {
+    const server_request_t request = {.type = SERVER_REQUEST_FRAME, .id = 42, .time = 0.5f};
+
+    if (send(fd, &request, sizeof(request), MSG_NOSIGNAL) != sizeof(request)) {
+        LOG_ERROR_ERRNO("send");
+        goto fail_exit;
+    }
+
+    server_reply_t reply;
+    if (recv(fd, &reply, sizeof(reply), 0) != sizeof(reply)) {
+        LOG_ERROR_ERRNO("recv");
+        goto fail_exit;
+    }
+
+    if (reply.id != request.id || reply.time != request.time) {
+        LOG_ERROR("reply %u at %f does not match request %u at %f", reply.id, reply.time, request.id,
+                  request.time);
+        goto fail_exit;
+    }
+
+    if (reply.slot < 0 || (uint32_t)reply.slot >= hello->slot_count) {
+        LOG_ERROR("reply names slot %d out of %u", reply.slot, hello->slot_count);
+        goto fail_exit;
+    }
+
+    /* the ring starts zeroed, a rendered frame has colors */
+    const unsigned char* frame = &ring[reply.slot * hello->slot_size];
+    size_t frame_size          = (size_t)hello->width * hello->height * hello->pixel_size;
+    bool drawn                 = false;
+
+    for (size_t i = 0; i < frame_size && !drawn; i++) {
+        drawn = frame[i] != 0;
+    }
+
+    if (!drawn) {
+        LOG_ERROR("slot %d is empty", reply.slot);
+        goto fail_exit;
+    }
+
+    const server_request_t release = {.type = SERVER_REQUEST_RELEASE, .slot = reply.slot};
+    if (send(fd, &release, sizeof(release), MSG_NOSIGNAL) != sizeof(release)) {
+        LOG_ERROR_ERRNO("send");
+        goto fail_exit;
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+/* the server reads whole messages, one of another size breaks the protocol */
+static int send_oversized(int fd) {
+    unsigned char message[sizeof(server_request_t) + 4] = {0};
+    const server_request_t request                      = {.type = SERVER_REQUEST_FRAME, .id = 43};
+    memcpy(message, &request, sizeof(request));
+
+    if (send(fd, message, sizeof(message), MSG_NOSIGNAL) != sizeof(message)) {
+        LOG_ERROR_ERRNO("send");
+        goto fail_exit;
+    }
+
+    server_reply_t reply;
+    ssize_t size = recv(fd, &reply, sizeof(reply), 0);
+    if (size > 0) {
+        LOG_ERROR("oversized request was answered");
+        goto fail_exit;
+    }
+
+    if (size < 0 && errno != ECONNRESET) {
+        LOG_ERROR_ERRNO("recv");
+        goto fail_exit;
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s SOCKET\n", argv[0]);
+        goto fail_exit;
+    }
+
+    int fd = connect_server(argv[1]);
+    if (fd < 0) {
+        goto fail_exit;
+    }
+
+    server_hello_t hello;
+    int memfd;
+    if (receive_hello(fd, &hello, &memfd) < 0) {
+        goto fail_close_socket;
+    }
+
+    size_t ring_size = hello.slot_size * hello.slot_count;
+    unsigned char* ring = mmap(NULL, ring_size, PROT_READ, MAP_SHARED, memfd, 0);
+    close(memfd);
+
+    if (ring == MAP_FAILED) {
+        LOG_ERROR_ERRNO("mmap");
+        goto fail_close_socket;
+    }
+
+    if (request_frame(fd, &hello, ring) < 0 || send_oversized(fd) < 0) {
+        goto fail_unmap_ring;
+    }
+
+    munmap(ring, ring_size);
+    close(fd);
+
+    return 0;
+
+fail_unmap_ring:
+    munmap(ring, ring_size);
+fail_close_socket:
+    close(fd);
+fail_exit:
+    return 1;
+}
@@ -0,0 +1,486 @@
+/* memfd_create */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "server.h"
+
+/* further connections are closed right away */
+#define SERVER_MAX_CLIENTS 32
+
+typedef struct server_pending {
+    int client;
+    uint32_t id;
+    unsigned int slot;
+} server_pending_t;
+
+typedef struct server {
+    sinoscope_t* sinoscope;
+    const char* path;
+    int listen_fd;
+
+    /* the ring, shared with every client */
+    int memfd;
+    unsigned char* ring;
+    size_t slot_size;
+    unsigned int slot_count;
+    /* socket of the client holding each slot, -1 when free */
+    int* owners;
+
+    /* listening socket first, then the clients and the read end of stop_pipe */
+    struct pollfd fds[SERVER_MAX_CLIENTS + 2];
+    unsigned int client_count;
+
+    /* frame requests of the current batch, at most one per slot */
+    server_pending_t* pending;
+    sinoscope_frame_t* frames;
+    unsigned char** buffers;
+    unsigned int pending_count;
+
+    long frames_served;
+    long batches;
+} server_t;
+
+static volatile sig_atomic_t server_stop = 0;
+/* written by the signal handler, poll would miss a signal taken just before it, or by another thread */
+static int stop_pipe[2] = {-1, -1};
+
+static void handle_stop(int signum) {
+    int saved_errno = errno;
+
+    server_stop = 1;
+    /* non-blocking, a full pipe already wakes poll */
+    if (write(stop_pipe[1], "", 1) < 0) {
+        /* nothing a handler can do */
+    }
+
+    errno = saved_errno;
+}
+
+static int acquire_slot(server_t* server, int client) {
+    for (unsigned int i = 0; i < server->slot_count; i++) {
+        if (server->owners[i] < 0) {
+            server->owners[i] = client;
+            return i;
+        }
+    }
+
+    return SERVER_SLOT_BUSY;
+}
+
+static void release_slots(server_t* server, int client) {
+    for (unsigned int i = 0; i < server->slot_count; i++) {
+        if (server->owners[i] == client) {
+            server->owners[i] = -1;
+        }
+    }
+}
+
+static void send_reply(server_t* server, int client, const server_reply_t* reply) {
+    /* a client that does not read its replies only loses its own frames */
+    if (send(client, reply, sizeof(*reply), MSG_DONTWAIT | MSG_NOSIGNAL) != sizeof(*reply) && reply->slot >= 0) {
+        server->owners[reply->slot] = -1;
+    }
+}
+
+static int send_hello(server_t* server, int client) {
+    server_hello_t hello = {
+        .version    = SERVER_PROTOCOL_VERSION,
+        .width      = server->sinoscope->width,
+        .height     = server->sinoscope->height,
+        .pixel_size = server->sinoscope->pixel_size,
+        .slot_count = server->slot_count,
+        .slot_size  = server->slot_size,
+    };
+
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct iovec iov     = {.iov_base = &hello, .iov_len = sizeof(hello)};
+    struct msghdr message = {
+        .msg_iov        = &iov,
+        .msg_iovlen     = 1,
+        .msg_control    = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level     = SOL_SOCKET;
+    cmsg->cmsg_type      = SCM_RIGHTS;
+    cmsg->cmsg_len       = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &server->memfd, sizeof(int));
+
+    if (sendmsg(client, &message, MSG_NOSIGNAL) != sizeof(hello)) {
+        LOG_ERROR_ERRNO("sendmsg");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void accept_client(server_t* server) {
+    int client = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (client < 0) {
+        LOG_ERROR_ERRNO("accept4");
+        return;
+    }
+
+    if (server->client_count == SERVER_MAX_CLIENTS) {
+        LOG_ERROR("too many clients, connection refused");
+        close(client);
+        return;
+    }
+
+    if (send_hello(server, client) < 0) {
+        close(client);
+        return;
+    }
+
+    server->client_count++;
+    server->fds[server->client_count] = (struct pollfd){.fd = client, .events = POLLIN};
+}
+
+static void remove_client(server_t* server, unsigned int index) {
+    int client = server->fds[index].fd;
+
+    release_slots(server, client);
+    close(client);
+
+    server->fds[index] = server->fds[server->client_count];
+    server->client_count--;
+}
+
+/* unless given, the phases are the ones sinoscope_corners derives from the requested time */
+static void frame_at(server_t* server, const server_request_t* request, sinoscope_frame_t* frame) {
+    sinoscope_t* sinoscope = server->sinoscope;
+
+    if (request->flags & SERVER_FLAG_PHASES) {
+        *frame = (sinoscope_frame_t){request->time, request->phase0, request->phase1};
+        return;
+    }
+
+    sinoscope->time = request->time;
+    sinoscope_corners(sinoscope);
+
+    *frame = (sinoscope_frame_t){request->time, sinoscope->phase0, sinoscope->phase1};
+}
+
+/* returns false when the client is gone or broke the protocol, its requests of this batch are dropped */
+static bool read_requests(server_t* server, int client) {
+    unsigned int first = server->pending_count;
+    server_request_t request;
+
+    while (true) {
+        /* MSG_TRUNC returns the real length, a longer message would otherwise pass as a request */
+        ssize_t size = recv(client, &request, sizeof(request), MSG_DONTWAIT | MSG_TRUNC);
+
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (size != sizeof(request)) {
+            break;
+        }
+
+        if (request.type == SERVER_REQUEST_RELEASE) {
+            if (request.slot < server->slot_count && server->owners[request.slot] == client) {
+                server->owners[request.slot] = -1;
+            }
+            continue;
+        }
+
+        if (request.type != SERVER_REQUEST_FRAME) {
+            break;
+        }
+
+        int slot = acquire_slot(server, client);
+        if (slot < 0) {
+            server_reply_t reply = {.id = request.id, .slot = SERVER_SLOT_BUSY};
+            send_reply(server, client, &reply);
+            continue;
+        }
+
+        server_pending_t* pending = &server->pending[server->pending_count];
+        *pending                  = (server_pending_t){client, request.id, slot};
+
+        frame_at(server, &request, &server->frames[server->pending_count]);
+        server->buffers[server->pending_count] = &server->ring[slot * server->slot_size];
+        server->pending_count++;
+    }
+
+    server->pending_count = first;
+    return false;
+}
+
+/* every request received since the previous batch, rendered at once by the active backend */
+static void render_batch(server_t* server) {
+    if (server->pending_count == 0) {
+        return;
+    }
+
+    bool failed = sinoscope_render_frames(server->sinoscope, server->frames, server->buffers,
+                                          server->pending_count) < 0;
+    if (failed) {
+        LOG_ERROR("failed to render frames with `%s`", server->sinoscope->name);
+    }
+
+    for (unsigned int i = 0; i < server->pending_count; i++) {
+        const server_pending_t* pending = &server->pending[i];
+        const sinoscope_frame_t* frame  = &server->frames[i];
+
+        server_reply_t reply = {
+            .id     = pending->id,
+            .slot   = pending->slot,
+            .time   = frame->time,
+            .phase0 = frame->phase0,
+            .phase1 = frame->phase1,
+        };
+
+        if (failed) {
+            server->owners[pending->slot] = -1;
+            reply.slot                    = SERVER_SLOT_FAILED;
+        }
+
+        send_reply(server, pending->client, &reply);
+    }
+
+    server->frames_served += failed ? 0 : server->pending_count;
+    server->batches++;
+    server->pending_count = 0;
+}
+
+static int serve(server_t* server) {
+    while (!server_stop) {
+        /* after the clients, whose count changes between the calls */
+        server->fds[server->client_count + 1] = (struct pollfd){.fd = stop_pipe[0], .events = POLLIN};
+
+        if (poll(server->fds, server->client_count + 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            LOG_ERROR_ERRNO("poll");
+            return -1;
+        }
+
+        /* backwards, a removed client is replaced by the last one */
+        for (unsigned int i = server->client_count; i > 0; i--) {
+            short revents = server->fds[i].revents;
+
+            if (revents == 0) {
+                continue;
+            }
+
+            if (!(revents & POLLIN) || !read_requests(server, server->fds[i].fd)) {
+                remove_client(server, i);
+            }
+        }
+
+        render_batch(server);
+
+        if (server->fds[0].revents & POLLIN) {
+            accept_client(server);
+        }
+    }
+
+    return 0;
+}
+
+/* sealed so that a client cannot shrink it under the renderer */
+static int create_ring(server_t* server) {
+    /* slots are aligned like the buffers of sinoscope_alloc_buffer, they are handed to the handlers */
+    server->slot_size = sinoscope_buffer_allocation(server->sinoscope->buffer_size);
+    size_t size = server->slot_size * server->slot_count;
+
+    server->memfd = memfd_create("sinoscope-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (server->memfd < 0) {
+        LOG_ERROR_ERRNO("memfd_create");
+        goto fail_exit;
+    }
+
+    if (ftruncate(server->memfd, size) < 0) {
+        LOG_ERROR_ERRNO("ftruncate");
+        goto fail_close_memfd;
+    }
+
+    if (fcntl(server->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        LOG_ERROR_ERRNO("fcntl");
+        goto fail_close_memfd;
+    }
+
+    server->ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, server->memfd, 0);
+    if (server->ring == MAP_FAILED) {
+        LOG_ERROR_ERRNO("mmap");
+        goto fail_close_memfd;
+    }
+
+    /* like sinoscope_alloc_buffer, every slot is placed for the threads rendering it */
+    for (unsigned int i = 0; i < server->slot_count; i++) {
+        sinoscope_openmp_first_touch(&server->ring[i * server->slot_size], server->slot_size);
+    }
+
+    return 0;
+
+fail_close_memfd:
+    close(server->memfd);
+fail_exit:
+    return -1;
+}
+
+static int create_socket(server_t* server) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+    if (strlen(server->path) >= sizeof(address.sun_path)) {
+        LOG_ERROR("socket path `%s` is too long", server->path);
+        goto fail_exit;
+    }
+    strcpy(address.sun_path, server->path);
+
+    /* a socket left by a previous server, anything else is not ours to remove */
+    struct stat status;
+    if (lstat(server->path, &status) == 0 && S_ISSOCK(status.st_mode)) {
+        unlink(server->path);
+    }
+
+    server->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (server->listen_fd < 0) {
+        LOG_ERROR_ERRNO("socket");
+        goto fail_exit;
+    }
+
+    if (bind(server->listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        LOG_ERROR_ERRNO("bind");
+        goto fail_close_socket;
+    }
+
+    if (listen(server->listen_fd, SERVER_MAX_CLIENTS) < 0) {
+        LOG_ERROR_ERRNO("listen");
+        goto fail_unlink_socket;
+    }
+
+    server->fds[0] = (struct pollfd){.fd = server->listen_fd, .events = POLLIN};
+
+    return 0;
+
+fail_unlink_socket:
+    unlink(server->path);
+fail_close_socket:
+    close(server->listen_fd);
+fail_exit:
+    return -1;
+}
+
+int server_run(sinoscope_t* sinoscope, const char* path, unsigned int slots) {
+    if (sinoscope == NULL || path == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    /* the pipelined handler returns the previous frame, replies would name the wrong one */
+    if (sinoscope->handler == sinoscope_image_opencl_async) {
+        LOG_ERROR("method `%s` cannot serve frames", sinoscope->name);
+        goto fail_exit;
+    }
+
+    server_t server = {
+        .sinoscope  = sinoscope,
+        .path       = path,
+        .slot_count = slots,
+    };
+
+    server.owners  = malloc(slots * sizeof(*server.owners));
+    server.pending = calloc(slots, sizeof(*server.pending));
+    server.frames  = calloc(slots, sizeof(*server.frames));
+    server.buffers = calloc(slots, sizeof(*server.buffers));
+    if (server.owners == NULL || server.pending == NULL || server.frames == NULL || server.buffers == NULL) {
+        LOG_ERROR_ERRNO("calloc");
+        goto fail_free_server;
+    }
+
+    for (unsigned int i = 0; i < slots; i++) {
+        server.owners[i] = -1;
+    }
+
+    if (create_ring(&server) < 0) {
+        LOG_ERROR("failed to create frame ring");
+        goto fail_free_server;
+    }
+
+    if (create_socket(&server) < 0) {
+        LOG_ERROR("failed to create socket");
+        goto fail_destroy_ring;
+    }
+
+    if (pipe2(stop_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        LOG_ERROR_ERRNO("pipe2");
+        goto fail_close_socket;
+    }
+
+    /* no SA_RESTART, poll returns on the signal */
+    struct sigaction action = {.sa_handler = handle_stop};
+    struct sigaction old_int, old_term;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+
+    printf("Serving %ux%u frames of %s on %s, %u slots\n", sinoscope->width, sinoscope->height, sinoscope->name,
+           path, slots);
+
+    int status = serve(&server);
+
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    server_stop = 0;
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    stop_pipe[0] = stop_pipe[1] = -1;
+
+    printf("Served %ld frames in %ld batches\n", server.frames_served, server.batches);
+
+    while (server.client_count > 0) {
+        remove_client(&server, server.client_count);
+    }
+
+    close(server.listen_fd);
+    unlink(path);
+    munmap(server.ring, server.slot_size * slots);
+    close(server.memfd);
+    free(server.buffers);
+    free(server.frames);
+    free(server.pending);
+    free(server.owners);
+
+    return status;
+
+fail_close_socket:
+    close(server.listen_fd);
+    unlink(path);
+fail_destroy_ring:
+    munmap(server.ring, server.slot_size * slots);
+    close(server.memfd);
+fail_free_server:
+    free(server.buffers);
+    free(server.frames);
+    free(server.pending);
+    free(server.owners);
+fail_exit:
+    return -1;
+}
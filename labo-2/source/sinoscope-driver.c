@@ -0,0 +1,244 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "log.h"
+#include "sinoscope.h"
+
+/* every thread starts rendering at the same time, or not at all when one of them could not be created */
+typedef struct driver_gate {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool open;
+    bool aborted;
+} driver_gate_t;
+
+typedef struct driver_thread {
+    sinoscope_t* sinoscope;
+    sinoscope_opencl_t opencl;
+    bool has_opencl;
+
+    unsigned int frames;
+    driver_gate_t* gate;
+
+    pthread_t thread;
+    int status;
+    double elapsed;
+} driver_thread_t;
+
+static double elapsed_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* returns false when the run was aborted */
+static bool gate_wait(driver_gate_t* gate) {
+    pthread_mutex_lock(&gate->lock);
+
+    while (!gate->open && !gate->aborted) {
+        pthread_cond_wait(&gate->cond, &gate->lock);
+    }
+
+    bool open = !gate->aborted;
+    pthread_mutex_unlock(&gate->lock);
+
+    return open;
+}
+
+static void gate_release(driver_gate_t* gate, bool aborted) {
+    pthread_mutex_lock(&gate->lock);
+    gate->open    = !aborted;
+    gate->aborted = aborted;
+    pthread_cond_broadcast(&gate->cond);
+    pthread_mutex_unlock(&gate->lock);
+}
+
+static void* driver_loop(void* data) {
+    driver_thread_t* driver = data;
+    sinoscope_t* sinoscope  = driver->sinoscope;
+
+    if (!gate_wait(driver->gate)) {
+        driver->status = -1;
+        return NULL;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned int i = 0; i < driver->frames; i++) {
+        if (sinoscope_corners(sinoscope) < 0) {
+            LOG_ERROR("failed to forward sinoscope");
+            goto fail_exit;
+        }
+
+        if (sinoscope->handler(sinoscope) < 0) {
+            LOG_ERROR("failed to call sinoscope handler `%s`", sinoscope->name);
+            goto fail_exit;
+        }
+    }
+
+    if (sinoscope_opencl_drain(sinoscope) < 0) {
+        LOG_ERROR("failed to drain sinoscope `%s`", sinoscope->name);
+        goto fail_exit;
+    }
+
+    driver->elapsed = elapsed_since(&start);
+    driver->status  = 0;
+
+    return NULL;
+
+fail_exit:
+    driver->status = -1;
+    return NULL;
+}
+
+static void destroy_drivers(driver_thread_t* drivers, unsigned int count) {
+    for (unsigned int i = 0; i < count; i++) {
+        sinoscope_destroy(drivers[i].sinoscope);
+
+        if (drivers[i].has_opencl) {
+            sinoscope_opencl_cleanup(&drivers[i].opencl);
+        }
+    }
+
+    free(drivers);
+}
+
+int sinoscope_driver(const char* name, const sinoscope_driver_instance_t* instances, unsigned int count,
+                     unsigned int frames, sinoscope_format_t format, sinoscope_opencl_t* opencl) {
+    const sinoscope_method_t* method = sinoscope_find_method(name);
+    if (method == NULL) {
+        LOG_ERROR("unknown method `%s`", name);
+        goto fail_exit;
+    }
+
+    if (method->opencl && opencl == NULL) {
+        LOG_ERROR("method `%s` requires an OpenCL device", method->name);
+        goto fail_exit;
+    }
+
+    if (!sinoscope_method_supports(method, format)) {
+        LOG_ERROR("method `%s` does not render %s", method->name, sinoscope_format_name(format));
+        goto fail_exit;
+    }
+
+    if (!sinoscope_method_renders(method, sinoscope_precision)) {
+        LOG_ERROR("method `%s` does not render the %s precision", method->name,
+                  sinoscope_precision_name(sinoscope_precision));
+        goto fail_exit;
+    }
+
+    driver_thread_t* drivers = calloc(count, sizeof(*drivers));
+    if (drivers == NULL) {
+        LOG_ERROR_ERRNO("calloc");
+        goto fail_exit;
+    }
+
+    unsigned int created = 0;
+    for (; created < count; created++) {
+        const sinoscope_driver_instance_t* instance = &instances[created];
+        driver_thread_t* driver                     = &drivers[created];
+
+        driver->sinoscope = sinoscope_create(method->name, method->handler, instance->width, instance->height,
+                                             instance->max, format);
+        if (driver->sinoscope == NULL) {
+            LOG_ERROR("failed to create sinoscope (%s)", method->name);
+            goto fail_destroy_drivers;
+        }
+        driver->sinoscope->taylor = instance->taylor;
+        driver->frames            = frames;
+
+        /* the context is shared, the queues are not: instances are scheduled independently by the device */
+        if (method->opencl) {
+            if (sinoscope_opencl_init_shared(&driver->opencl, opencl, instance->width, instance->height) < 0) {
+                LOG_ERROR("failed to init OpenCL instance %u", created);
+                sinoscope_opencl_cleanup(&driver->opencl);
+                sinoscope_destroy(driver->sinoscope);
+                goto fail_destroy_drivers;
+            }
+
+            driver->has_opencl        = true;
+            driver->sinoscope->opencl = &driver->opencl;
+        }
+    }
+
+    driver_gate_t gate = {.open = false, .aborted = false};
+    pthread_mutex_init(&gate.lock, NULL);
+    pthread_cond_init(&gate.cond, NULL);
+
+    unsigned int started = 0;
+    for (; started < count; started++) {
+        drivers[started].gate = &gate;
+
+        errno = pthread_create(&drivers[started].thread, NULL, driver_loop, &drivers[started]);
+        if (errno != 0) {
+            LOG_ERROR_ERRNO("pthread_create");
+            break;
+        }
+    }
+
+    if (started < count) {
+        gate_release(&gate, true);
+        for (unsigned int i = 0; i < started; i++) {
+            pthread_join(drivers[i].thread, NULL);
+        }
+        goto fail_destroy_gate;
+    }
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    gate_release(&gate, false);
+
+    int status = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        errno = pthread_join(drivers[i].thread, NULL);
+        if (errno != 0) {
+            LOG_ERROR_ERRNO("pthread_join");
+            status = -1;
+        }
+
+        status = (drivers[i].status < 0) ? -1 : status;
+    }
+
+    double elapsed = elapsed_since(&start_time);
+
+    if (status < 0) {
+        LOG_ERROR("failed to render with `%s`", method->name);
+        goto fail_destroy_gate;
+    }
+
+    printf("=========================================================================\n");
+    printf("driver: %u instances of %s, %u frames each\n", count, method->name, frames);
+    printf("instance   width   height   taylor        max   elapsed (s)        fps\n");
+
+    double pixels = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        const sinoscope_t* sinoscope = drivers[i].sinoscope;
+
+        printf("%8u   %5u    %5u    %5u   %8.2f   %11.3f   %8.1f\n", i, sinoscope->width, sinoscope->height,
+               sinoscope->taylor, sinoscope->max, drivers[i].elapsed, frames / drivers[i].elapsed);
+
+        pixels += (double)sinoscope->width * sinoscope->height * frames;
+    }
+
+    printf("aggregate: %u frames in %.3f s (%.1f fps, %.1f Mpixel/s)\n", count * frames, elapsed,
+           count * frames / elapsed, pixels / elapsed / 1e6);
+    printf("=========================================================================\n");
+
+    pthread_cond_destroy(&gate.cond);
+    pthread_mutex_destroy(&gate.lock);
+    destroy_drivers(drivers, count);
+
+    return 0;
+
+fail_destroy_gate:
+    pthread_cond_destroy(&gate.cond);
+    pthread_mutex_destroy(&gate.lock);
+fail_destroy_drivers:
+    destroy_drivers(drivers, created);
+fail_exit:
+    return -1;
+}
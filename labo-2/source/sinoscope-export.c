@@ -0,0 +1,340 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "image.h"
+#include "log.h"
+#include "sinoscope.h"
+
+typedef struct export_job {
+    unsigned int frame;
+    unsigned char* buffer;
+} export_job_t;
+
+/*
+ * Frames waiting for an encoder. Twice the batch of buffers circulate
+ * between the renderer and the encoders, so one batch is rendered while
+ * the previous one is encoded.
+ */
+typedef struct export_pool {
+    const char* pattern;
+    unsigned int width;
+    unsigned int height;
+    unsigned int channels;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    export_job_t* jobs;
+    unsigned int job_head;
+    unsigned int job_count;
+
+    unsigned char** buffers;
+    unsigned int buffer_count;
+    unsigned char** free_buffers;
+    unsigned int free_count;
+
+    bool closed;
+    bool failed;
+
+    pthread_t* threads;
+    unsigned int thread_count;
+} export_pool_t;
+
+static void release_buffer(export_pool_t* pool, unsigned char* buffer, bool failed) {
+    pthread_mutex_lock(&pool->lock);
+    pool->free_buffers[pool->free_count++] = buffer;
+    pool->failed                          = pool->failed || failed;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static unsigned char* acquire_buffer(export_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->free_count == 0) {
+        pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+
+    unsigned char* buffer = pool->free_buffers[--pool->free_count];
+    pthread_mutex_unlock(&pool->lock);
+
+    return buffer;
+}
+
+static void* encoder_loop(void* data) {
+    export_pool_t* pool = data;
+    char filename[4096];
+
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+
+        while (pool->job_count == 0 && !pool->closed) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+
+        if (pool->job_count == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+
+        export_job_t job = pool->jobs[pool->job_head];
+        pool->job_head   = (pool->job_head + 1) % pool->buffer_count;
+        pool->job_count--;
+
+        pthread_mutex_unlock(&pool->lock);
+
+        snprintf(filename, sizeof(filename), pool->pattern, job.frame);
+        int status = image_save_png_packed(job.buffer, pool->width, pool->height, pool->channels, filename);
+
+        release_buffer(pool, job.buffer, status < 0);
+    }
+
+    return NULL;
+}
+
+static void submit_job(export_pool_t* pool, unsigned int frame, unsigned char* buffer) {
+    pthread_mutex_lock(&pool->lock);
+
+    /* the queue holds every buffer, it never overflows */
+    unsigned int tail = (pool->job_head + pool->job_count) % pool->buffer_count;
+    pool->jobs[tail]  = (export_job_t){frame, buffer};
+    pool->job_count++;
+
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void pool_destroy(export_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->closed = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned int i = 0; i < pool->thread_count; i++) {
+        errno = pthread_join(pool->threads[i], NULL);
+        if (errno != 0) {
+            LOG_ERROR_ERRNO("pthread_join");
+        }
+    }
+
+    for (unsigned int i = 0; i < pool->buffer_count; i++) {
+        free(pool->buffers[i]);
+    }
+
+    free(pool->threads);
+    free(pool->free_buffers);
+    free(pool->buffers);
+    free(pool->jobs);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+static int pool_create(export_pool_t* pool, sinoscope_t* sinoscope, const char* pattern, unsigned int buffer_count,
+                       unsigned int thread_count) {
+    memset(pool, 0, sizeof(*pool));
+
+    pool->pattern = pattern;
+    pool->width    = sinoscope->width;
+    pool->height   = sinoscope->height;
+    pool->channels = sinoscope->pixel_size;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    pool->jobs         = calloc(buffer_count, sizeof(*pool->jobs));
+    pool->buffers      = calloc(buffer_count, sizeof(*pool->buffers));
+    pool->free_buffers = calloc(buffer_count, sizeof(*pool->free_buffers));
+    pool->threads      = calloc(thread_count + 1, sizeof(*pool->threads));
+    if (pool->jobs == NULL || pool->buffers == NULL || pool->free_buffers == NULL || pool->threads == NULL) {
+        LOG_ERROR_ERRNO("calloc");
+        goto fail_destroy_pool;
+    }
+
+    for (unsigned int i = 0; i < buffer_count; i++) {
+        pool->buffers[i] = sinoscope_alloc_buffer(sinoscope->buffer_size);
+        if (pool->buffers[i] == NULL) {
+            LOG_ERROR("failed to allocate export buffer");
+            goto fail_destroy_pool;
+        }
+
+        pool->buffer_count++;
+        pool->free_buffers[pool->free_count++] = pool->buffers[i];
+    }
+
+    for (unsigned int i = 0; i < thread_count; i++) {
+        errno = pthread_create(&pool->threads[i], NULL, encoder_loop, pool);
+        if (errno != 0) {
+            LOG_ERROR_ERRNO("pthread_create");
+            goto fail_destroy_pool;
+        }
+
+        pool->thread_count++;
+    }
+
+    return 0;
+
+fail_destroy_pool:
+    pool_destroy(pool);
+    return -1;
+}
+
+/* the pattern is a printf format, it must take exactly one integer */
+static bool valid_pattern(const char* pattern) {
+    unsigned int conversions = 0;
+
+    for (const char* cursor = pattern; *cursor != '\0'; cursor++) {
+        if (*cursor != '%') {
+            continue;
+        }
+
+        cursor++;
+        if (*cursor == '%') {
+            continue;
+        }
+
+        cursor += strspn(cursor, "0123456789-+ #");
+        if (*cursor != 'd' && *cursor != 'u') {
+            return false;
+        }
+
+        conversions++;
+    }
+
+    return conversions == 1;
+}
+
+/* frames of the batch are rendered one by one by the handler of the sinoscope */
+static int render_frames(sinoscope_t* sinoscope, const sinoscope_frame_t* frames, unsigned char** buffers,
+                         unsigned int count) {
+    unsigned char* buffer = sinoscope->buffer;
+    int status            = 0;
+
+    for (unsigned int i = 0; i < count && status == 0; i++) {
+        sinoscope->time   = frames[i].time;
+        sinoscope->phase0 = frames[i].phase0;
+        sinoscope->phase1 = frames[i].phase1;
+        sinoscope->buffer = buffers[i];
+
+        status = sinoscope->handler(sinoscope);
+    }
+
+    sinoscope->buffer = buffer;
+
+    return status;
+}
+
+int sinoscope_render_frames(sinoscope_t* sinoscope, const sinoscope_frame_t* frames, unsigned char** buffers,
+                            unsigned int count) {
+    const sinoscope_method_t* method = sinoscope_find_method(sinoscope->name);
+    /* the batch path only writes packed RGB with the default precision */
+    bool openmp = method != NULL && !method->opencl && (method->tunables & SINOSCOPE_TUNE_THREADS) &&
+                  sinoscope->format == SINOSCOPE_FORMAT_RGB8 && sinoscope->precision == SINOSCOPE_PRECISION_DEFAULT;
+
+    return openmp ? sinoscope_openmp_render_batch(sinoscope, frames, buffers, count)
+                  : render_frames(sinoscope, frames, buffers, count);
+}
+
+int sinoscope_export(sinoscope_t* sinoscope, const char* pattern, FILE* raw, unsigned int frames, unsigned int batch,
+                     unsigned int jobs) {
+    if (sinoscope == NULL || (pattern == NULL && raw == NULL)) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    if (raw == NULL && !valid_pattern(pattern)) {
+        LOG_ERROR("pattern `%s` must contain one %%d conversion", pattern);
+        goto fail_exit;
+    }
+
+    /* the pipelined handler returns the previous frame, frames would come out shifted */
+    if (sinoscope->handler == sinoscope_image_opencl_async) {
+        LOG_ERROR("method `%s` cannot export frames", sinoscope->name);
+        goto fail_exit;
+    }
+
+    sinoscope_frame_t* states = calloc(batch, sizeof(*states));
+    unsigned char** buffers   = calloc(batch, sizeof(*buffers));
+    if (states == NULL || buffers == NULL) {
+        LOG_ERROR_ERRNO("calloc");
+        goto fail_free_batch;
+    }
+
+    export_pool_t pool;
+    if (pool_create(&pool, sinoscope, pattern, 2 * batch, raw != NULL ? 0 : jobs) < 0) {
+        goto fail_free_batch;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned int first = 0; first < frames; first += batch) {
+        unsigned int count = (frames - first < batch) ? frames - first : batch;
+
+        for (unsigned int i = 0; i < count; i++) {
+            if (sinoscope_corners(sinoscope) < 0) {
+                LOG_ERROR("failed to forward sinoscope");
+                goto fail_destroy_pool;
+            }
+
+            states[i]  = (sinoscope_frame_t){sinoscope->time, sinoscope->phase0, sinoscope->phase1};
+            buffers[i] = acquire_buffer(&pool);
+        }
+
+        if (sinoscope_render_frames(sinoscope, states, buffers, count) < 0) {
+            LOG_ERROR("failed to render frames with `%s`", sinoscope->name);
+            for (unsigned int i = 0; i < count; i++) {
+                release_buffer(&pool, buffers[i], false);
+            }
+            goto fail_destroy_pool;
+        }
+
+        for (unsigned int i = 0; i < count; i++) {
+            if (raw == NULL) {
+                submit_job(&pool, first + i, buffers[i]);
+                continue;
+            }
+
+            size_t written = fwrite(buffers[i], 1, sinoscope->buffer_size, raw);
+            release_buffer(&pool, buffers[i], false);
+
+            if (written != sinoscope->buffer_size) {
+                LOG_ERROR_ERRNO("fwrite");
+                goto fail_destroy_pool;
+            }
+        }
+    }
+
+    /* waits for the encoders to empty the queue */
+    pool_destroy(&pool);
+    free(buffers);
+    free(states);
+
+    if (pool.failed) {
+        LOG_ERROR("failed to encode frames");
+        goto fail_exit;
+    }
+
+    if (raw != NULL && fflush(raw) != 0) {
+        LOG_ERROR_ERRNO("fflush");
+        goto fail_exit;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("Exported %u frames in %.2f s (%.1f fps)\n", frames, elapsed, frames / elapsed);
+
+    return 0;
+
+fail_destroy_pool:
+    pool_destroy(&pool);
+fail_free_batch:
+    free(buffers);
+    free(states);
+fail_exit:
+    return -1;
+}
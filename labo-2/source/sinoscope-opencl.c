@@ -1,6 +1,12 @@
 #define CL_USE_DEPRECATED_OPENCL_1_2_APIS
 
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
 #include "log.h"
+#include "opencl-cache.h"
 #include "sinoscope.h"
 
 typedef struct modified_sinoscope {
@@ -9,80 +15,568 @@ typedef struct modified_sinoscope {
     unsigned int height;
     unsigned int taylor;
     unsigned int interval;
+    /* 3 for SINOSCOPE_FORMAT_RGB8, 4 for SINOSCOPE_FORMAT_RGBA8 */
+    unsigned int pixel_size;
 } modified_sinoscope_t;
 
-int sinoscope_opencl_init(sinoscope_opencl_t* opencl, cl_device_id opencl_device_id, unsigned int width, unsigned int height) {
+/* pixels per work item of the 2D kernel, same as STRIP_WIDTH in sinoscope.cl */
+static const size_t STRIP_WIDTH = 4;
 
-	/* Initialiser le matériel, contexte et queue de commandes */
-	cl_int error = 0;
-	opencl->device_id = opencl_device_id;
+/* local sizes tried by the auto-tuning, {0, 0} lets the runtime choose */
+static const size_t TUNE_LOCAL_SIZES[][2] = {
+	{0, 0}, {8, 1}, {16, 1}, {32, 1}, {64, 1}, {8, 4}, {16, 4}, {32, 4}, {8, 8}, {16, 8}, {32, 8}, {16, 16},
+};
+static const unsigned int TUNE_TAYLOR = 6;
+static const unsigned int TUNE_ITERATIONS = 3;
 
-	opencl->context = clCreateContext(0, 1, &opencl_device_id, NULL, NULL, &error);
+/* smallest share of the rows left to either side of the hybrid handler, both keep being measured */
+static const float HYBRID_MIN_SHARE = 1.0f / 32;
+
+/* the global size is rounded up to a multiple of the local size, the kernel skips the extra items */
+static void strip_global_size(sinoscope_opencl_t* opencl, unsigned int width, unsigned int height, size_t* global) {
+	global[0] = (width + STRIP_WIDTH - 1) / STRIP_WIDTH;
+	global[1] = height;
+
+	if (opencl->local_size[0] != 0) {
+		global[0] = (global[0] + opencl->local_size[0] - 1) / opencl->local_size[0] * opencl->local_size[0];
+		global[1] = (global[1] + opencl->local_size[1] - 1) / opencl->local_size[1] * opencl->local_size[1];
+	}
+}
+
+static cl_int enqueue_strip(sinoscope_opencl_t* opencl, unsigned int width, unsigned int height, cl_event* event) {
+	size_t global[2];
+	strip_global_size(opencl, width, height, global);
+
+	const size_t* local = (opencl->local_size[0] != 0) ? opencl->local_size : NULL;
+	return clEnqueueNDRangeKernel(opencl->queue, opencl->strip_kernel, 2, NULL, global, local, 0, NULL, event);
+}
+
+/* event to pass to a timed command, NULL when the queues do not profile so that the runtime creates none */
+static cl_event* profiled(sinoscope_opencl_t* opencl, cl_event* event) {
+	*event = NULL;
+	return opencl->profiling ? event : NULL;
+}
+
+/* adds the device time of the finished command to `phase` and releases its event */
+static void record_event(sinoscope_t* sinoscope, sinoscope_phase_t phase, cl_event event) {
+	if (event == NULL) {
+		return;
+	}
+
+	cl_ulong start, end;
+	if (sinoscope->opencl->profiling &&
+	    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) == CL_SUCCESS &&
+	    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) == CL_SUCCESS) {
+		double previous = (sinoscope->phases[phase] > 0) ? sinoscope->phases[phase] : 0;
+		sinoscope->phases[phase] = previous + (end - start) / 1e3;
+	}
+
+	clReleaseEvent(event);
+}
+
+static void record_host(sinoscope_t* sinoscope, sinoscope_phase_t phase, const struct timespec* start) {
+	if (!sinoscope->opencl->profiling) {
+		return;
+	}
+
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double previous = (sinoscope->phases[phase] > 0) ? sinoscope->phases[phase] : 0;
+	sinoscope->phases[phase] = previous + (end.tv_sec - start->tv_sec) * 1e6 + (end.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static int local_size_fits(sinoscope_opencl_t* opencl, const size_t* local_size) {
+	size_t kernel_max;
+	cl_int error = clGetKernelWorkGroupInfo(opencl->strip_kernel, opencl->device_id, CL_KERNEL_WORK_GROUP_SIZE,
+						 sizeof(kernel_max), &kernel_max, NULL);
 	if (error != CL_SUCCESS) {
-		LOG_ERROR("Failed to create OpenCL context: %d", error);
-		goto fail_exit;
+		LOG_ERROR("Failed to query OpenCL work group size: %d", error);
+		return -1;
+	}
+
+	size_t item_max[3];
+	error = clGetDeviceInfo(opencl->device_id, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(item_max), item_max, NULL);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to query OpenCL work item sizes: %d", error);
+		return -1;
+	}
+
+	return local_size[0] * local_size[1] <= kernel_max && local_size[0] <= item_max[0] && local_size[1] <= item_max[1];
+}
+
+int sinoscope_opencl_set_local_size(sinoscope_opencl_t* opencl, const size_t* local_size) {
+	int fits = local_size_fits(opencl, local_size);
+	if (fits < 0) {
+		return -1;
+	}
+
+	if (!fits) {
+		LOG_ERROR("OpenCL local size %zux%zu is not supported by the device", local_size[0], local_size[1]);
+		return -1;
+	}
+
+	opencl->local_size[0] = local_size[0];
+	opencl->local_size[1] = local_size[1];
+
+	return 0;
+}
+
+/*
+ * Times a few frames of the 2D kernel into the device buffer for every
+ * candidate local size and keeps the fastest one. The arguments only need
+ * to be representative, they are set again by the first frame.
+ */
+static int tune_local_size(sinoscope_opencl_t* opencl, unsigned int width, unsigned int height) {
+	modified_sinoscope_t mod_sinoscope = {width * height * 3, width, height, TUNE_TAYLOR, 40, 3};
+	float interval_inverse = 1.0f / 40;
+	float time = 0, max = 200, phase = 1;
+	float dx = 4 * M_PI / height;
+	float dy = 4 * M_PI / width;
+
+	cl_int error = clSetKernelArg(opencl->strip_kernel, 0, sizeof(cl_mem), &opencl->buffer);
+	error |= clSetKernelArg(opencl->strip_kernel, 1, sizeof(modified_sinoscope_t), &mod_sinoscope);
+	error |= clSetKernelArg(opencl->strip_kernel, 2, sizeof(float), &interval_inverse);
+	error |= clSetKernelArg(opencl->strip_kernel, 3, sizeof(float), &time);
+	error |= clSetKernelArg(opencl->strip_kernel, 4, sizeof(float), &max);
+	error |= clSetKernelArg(opencl->strip_kernel, 5, sizeof(float), &phase);
+	error |= clSetKernelArg(opencl->strip_kernel, 6, sizeof(float), &phase);
+	error |= clSetKernelArg(opencl->strip_kernel, 7, sizeof(float), &dx);
+	error |= clSetKernelArg(opencl->strip_kernel, 8, sizeof(float), &dy);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to set OpenCL kernel arguments: %d", error);
+		return -1;
+	}
+
+	double best_time = -1;
+	size_t best[2] = {0, 0};
+
+	for (unsigned int c = 0; c < sizeof(TUNE_LOCAL_SIZES) / sizeof(TUNE_LOCAL_SIZES[0]); c++) {
+		opencl->local_size[0] = TUNE_LOCAL_SIZES[c][0];
+		opencl->local_size[1] = TUNE_LOCAL_SIZES[c][1];
+
+		if (opencl->local_size[0] != 0) {
+			int fits = local_size_fits(opencl, opencl->local_size);
+			if (fits < 0) {
+				return -1;
+			}
+			if (!fits) {
+				continue;
+			}
+		}
+
+		/* the first launch is a warmup, a size the runtime rejects is skipped */
+		if (enqueue_strip(opencl, width, height, NULL) != CL_SUCCESS || clFinish(opencl->queue) != CL_SUCCESS) {
+			continue;
+		}
+
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (unsigned int i = 0; i < TUNE_ITERATIONS; i++) {
+			enqueue_strip(opencl, width, height, NULL);
+		}
+		clFinish(opencl->queue);
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+		if (best_time < 0 || elapsed < best_time) {
+			best_time = elapsed;
+			best[0] = opencl->local_size[0];
+			best[1] = opencl->local_size[1];
+		}
 	}
 
-	opencl->queue = clCreateCommandQueue(opencl->context, opencl_device_id, 0, &error);
+	opencl->local_size[0] = best[0];
+	opencl->local_size[1] = best[1];
+
+	return 0;
+}
+
+/* queues, buffers and kernels of one sinoscope size, on the context and program already in `opencl` */
+static int init_instance(sinoscope_opencl_t* opencl, unsigned int width, unsigned int height) {
+	cl_int error = 0;
+	cl_device_id opencl_device_id = opencl->device_id;
+
+	opencl->profiling = sinoscope_profile;
+	opencl->kernel_events[0] = NULL;
+	opencl->kernel_events[1] = NULL;
+	const cl_command_queue_properties properties = opencl->profiling ? CL_QUEUE_PROFILING_ENABLE : 0;
+
+	opencl->queue = clCreateCommandQueue(opencl->context, opencl_device_id, properties, &error);
 	if (error != CL_SUCCESS) { 
 		LOG_ERROR("Failed to create OpenCL command queue: %d", error);
 		goto fail_exit;
 	}
 
-	const int buffer_size = width * height * 3;
+	opencl->transfer_queue = clCreateCommandQueue(opencl->context, opencl_device_id, properties, &error);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to create OpenCL command queue: %d", error);
+		goto fail_exit;
+	}
+
+	/* large enough for any format of the sinoscopes sharing the context */
+	const int buffer_size = width * height * SINOSCOPE_PIXEL_SIZE_MAX;
 	opencl->buffer = clCreateBuffer(opencl->context, CL_MEM_READ_WRITE, buffer_size, NULL, &error);
 	if (error != CL_SUCCESS) {
 		LOG_ERROR("Failed to create OpenCL buffer: %d", error);
 		goto fail_exit;
 	}
 
-	size_t size;
-	char* src = NULL;
-	opencl_load_kernel_code(&src, &size);
-	cl_program pgm = clCreateProgramWithSource(opencl->context, 1, (const char**) &src, &size, &error);
-	free(src);
+	opencl->back_buffer = clCreateBuffer(opencl->context, CL_MEM_READ_WRITE, buffer_size, NULL, &error);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to create OpenCL buffer: %d", error);
+		goto fail_exit;
+	}
+
+	/* use-host wraps the sinoscope buffers, as the frames reach them */
+	opencl->mapped = NULL;
+	for (unsigned int w = 0; w < SINOSCOPE_OPENCL_WRAPPERS; w++) {
+		opencl->wrappers[w].host   = NULL;
+		opencl->wrappers[w].buffer = NULL;
+	}
+	opencl->next_wrapper = 0;
 
+	if (opencl->memory == SINOSCOPE_OPENCL_MEMORY_ALLOC_HOST) {
+		opencl->mapped = clCreateBuffer(opencl->context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, buffer_size, NULL, &error);
+		if (error != CL_SUCCESS) {
+			LOG_ERROR("Failed to create OpenCL buffer: %d", error);
+			goto fail_exit;
+		}
+	}
+
+	/* host buffers are allocated by the first async frame, with the sinoscope buffer size */
+	opencl->host_buffers[0] = NULL;
+	opencl->host_buffers[1] = NULL;
+	opencl->read_events[0]  = NULL;
+	opencl->read_events[1]  = NULL;
+	opencl->in_flight       = -1;
+	opencl->next_slot       = 0;
+	opencl->hybrid_share    = 0.5f;
+
+	opencl->kernel = clCreateKernel(opencl->program, "sinoscope_image_kernel", &error);
 	if(error != CL_SUCCESS) {
-		LOG_ERROR("Failed to create OpenCL program: %d", error);
+		LOG_ERROR("Failed to create OpenCL kernel: %d", error);
+		goto fail_exit;
+	}
+
+	/* large enough for the double series of SINOSCOPE_PRECISION_DOUBLE */
+	opencl->terms = clCreateBuffer(opencl->context, CL_MEM_READ_WRITE, (width + height) * sizeof(double), NULL, &error);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to create OpenCL buffer: %d", error);
 		goto fail_exit;
 	}
 
-	const char* options = "-I " __OPENCL_INCLUDE__;
+	opencl->palette = clCreateBuffer(opencl->context, CL_MEM_READ_ONLY, COLOR_PALETTE_SIZE * sizeof(pixel_t), NULL, &error);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to create OpenCL buffer: %d", error);
+		goto fail_exit;
+	}
+	opencl->palette_interval = 0;
 
-	error = clBuildProgram(pgm, 1, &opencl_device_id, options, NULL, NULL);
-	opencl_print_build_log(pgm, opencl_device_id);
+	opencl->terms_kernel = clCreateKernel(opencl->program, "sinoscope_terms_kernel", &error);
 	if(error != CL_SUCCESS) {
-		LOG_ERROR("Failed to build OpenCL program: %d", error);
+		LOG_ERROR("Failed to create OpenCL kernel: %d", error);
 		goto fail_exit;
 	}
 
+	opencl->separable_kernel = clCreateKernel(opencl->program, "sinoscope_separable_kernel", &error);
+	if(error != CL_SUCCESS) {
+		LOG_ERROR("Failed to create OpenCL kernel: %d", error);
+		goto fail_exit;
+	}
 
-	opencl->kernel = clCreateKernel(pgm, "sinoscope_image_kernel", &error);
+	opencl->strip_kernel = clCreateKernel(opencl->program, "sinoscope_strip_kernel", &error);
 	if(error != CL_SUCCESS) {
 		LOG_ERROR("Failed to create OpenCL kernel: %d", error);
 		goto fail_exit;
 	}
 
+	/* buffers never change, the image buffers are set per frame for double buffering and mapping */
+	error = clSetKernelArg(opencl->kernel, 9, sizeof(cl_mem), &opencl->palette);
+	error |= clSetKernelArg(opencl->strip_kernel, 9, sizeof(cl_mem), &opencl->palette);
+	error |= clSetKernelArg(opencl->terms_kernel, 0, sizeof(cl_mem), &opencl->terms);
+	error |= clSetKernelArg(opencl->separable_kernel, 1, sizeof(cl_mem), &opencl->terms);
+	error |= clSetKernelArg(opencl->separable_kernel, 4, sizeof(cl_mem), &opencl->palette);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to set OpenCL kernel arguments: %d", error);
+		goto fail_exit;
+	}
+
+	if (opencl->local_size[0] == 0) {
+		if (tune_local_size(opencl, width, height) < 0) {
+			goto fail_exit;
+		}
+	} else if (sinoscope_opencl_set_local_size(opencl, opencl->local_size) < 0) {
+		goto fail_exit;
+	}
+
+	opencl->args_taylor   = 0;
+	opencl->args_interval = 0;
+	opencl->args_width    = 0;
+	opencl->args_height   = 0;
+	opencl->args_pixel_size = 0;
+
 	return 0;
 
 fail_exit:
 	return -1;
 }
 
+
+static bool supports_double(cl_device_id device_id) {
+	cl_device_fp_config config = 0;
+
+	cl_int error = clGetDeviceInfo(device_id, CL_DEVICE_DOUBLE_FP_CONFIG, sizeof(config), &config, NULL);
+
+	return error == CL_SUCCESS && config != 0;
+}
+
+int sinoscope_opencl_init(sinoscope_opencl_t* opencl, cl_device_id opencl_device_id, unsigned int width, unsigned int height) {
+
+	/* Initialiser le matériel, contexte et queue de commandes */
+	cl_int error = 0;
+	opencl->device_id = opencl_device_id;
+
+	opencl->context = clCreateContext(0, 1, &opencl_device_id, NULL, NULL, &error);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to create OpenCL context: %d", error);
+		goto fail_exit;
+	}
+
+	if (opencl->precision == SINOSCOPE_PRECISION_DOUBLE && !supports_double(opencl_device_id)) {
+		LOG_ERROR("OpenCL device does not support double precision");
+		goto fail_exit;
+	}
+
+	size_t size;
+	char* src = NULL;
+	if (opencl_load_kernel_code(&src, &size) < 0) {
+		LOG_ERROR("Failed to load OpenCL kernel code");
+		goto fail_exit;
+	}
+
+	/* the precision is a define of the kernel, a program is built for a single one */
+	char options[256];
+	snprintf(options, sizeof(options), "-I " __OPENCL_INCLUDE__ " -DSINOSCOPE_PRECISION=%d%s", opencl->precision,
+		 (opencl->precision == SINOSCOPE_PRECISION_NATIVE) ? " -cl-fast-relaxed-math" : "");
+
+	/* helpers.cl is part of the cache key, it is included by the kernel */
+	const char* const dependencies[] = {__OPENCL_INCLUDE__ "/helpers.cl", NULL};
+
+	int ret = opencl_cache_build_program(opencl->context, opencl_device_id, src, size, options, dependencies,
+					     &opencl->program);
+	free(src);
+
+	if (ret < 0) {
+		LOG_ERROR("Failed to build OpenCL program");
+		goto fail_exit;
+	}
+
+	if (init_instance(opencl, width, height) < 0) {
+		goto fail_exit;
+	}
+
+	return 0;
+
+fail_exit:
+	return -1;
+}
+
+int sinoscope_opencl_init_shared(sinoscope_opencl_t* opencl, const sinoscope_opencl_t* parent, unsigned int width,
+				 unsigned int height) {
+	opencl->device_id = parent->device_id;
+	opencl->context = parent->context;
+	opencl->program = parent->program;
+	opencl->memory = parent->memory;
+	opencl->precision = parent->precision;
+	opencl->local_size[0] = parent->local_size[0];
+	opencl->local_size[1] = parent->local_size[1];
+
+	/* released again by sinoscope_opencl_cleanup, whichever instance goes first */
+	clRetainContext(opencl->context);
+	clRetainProgram(opencl->program);
+
+	return init_instance(opencl, width, height);
+}
+
 void sinoscope_opencl_cleanup(sinoscope_opencl_t* opencl)
 {
+	clFinish(opencl->queue);
+	clFinish(opencl->transfer_queue);
+
+	for (int i = 0; i < 2; i++) {
+		if (opencl->read_events[i] != NULL) {
+			clReleaseEvent(opencl->read_events[i]);
+		}
+		if (opencl->kernel_events[i] != NULL) {
+			clReleaseEvent(opencl->kernel_events[i]);
+		}
+		free(opencl->host_buffers[i]);
+	}
+
 	clReleaseKernel(opencl->kernel);
+	clReleaseKernel(opencl->terms_kernel);
+	clReleaseKernel(opencl->separable_kernel);
+	clReleaseKernel(opencl->strip_kernel);
 	clReleaseCommandQueue(opencl->queue);
+	clReleaseCommandQueue(opencl->transfer_queue);
+	clReleaseProgram(opencl->program);
 	clReleaseContext(opencl->context);
 	clReleaseMemObject(opencl->buffer);
+	clReleaseMemObject(opencl->back_buffer);
+	if (opencl->mapped != NULL) {
+		clReleaseMemObject(opencl->mapped);
+	}
+	for (unsigned int w = 0; w < SINOSCOPE_OPENCL_WRAPPERS; w++) {
+		if (opencl->wrappers[w].buffer != NULL) {
+			clReleaseMemObject(opencl->wrappers[w].buffer);
+		}
+	}
+	clReleaseMemObject(opencl->terms);
+	clReleaseMemObject(opencl->palette);
 }
 
-int sinoscope_image_opencl(sinoscope_t* sinoscope) {
-	if (sinoscope == NULL) {
-        LOG_ERROR_NULL_PTR();
-        goto fail_exit;
-    }
-	cl_int error = 0;
+static int upload_palette(sinoscope_t* sinoscope) {
+	sinoscope_opencl_t* opencl = sinoscope->opencl;
+
+	if (opencl->palette_interval == sinoscope->interval) {
+		return 0;
+	}
+
+	cl_int error = clEnqueueWriteBuffer(opencl->queue, opencl->palette, CL_TRUE, 0, COLOR_PALETTE_SIZE * sizeof(pixel_t),
+					    sinoscope->palette, 0, NULL, NULL);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to write palette: %d", error);
+		return -1;
+	}
+
+	opencl->palette_interval = sinoscope->interval;
+	return 0;
+}
+
+const char* sinoscope_opencl_memory_name(sinoscope_opencl_memory_t memory) {
+	switch (memory) {
+	case SINOSCOPE_OPENCL_MEMORY_COPY:
+		return "copy";
+	case SINOSCOPE_OPENCL_MEMORY_ALLOC_HOST:
+		return "alloc-host";
+	case SINOSCOPE_OPENCL_MEMORY_USE_HOST:
+		return "use-host";
+	}
+
+	return "unknown";
+}
+
+/* device buffer the synchronous handlers render into */
+static int output_buffer(sinoscope_t* sinoscope, cl_mem* output) {
+	sinoscope_opencl_t* opencl = sinoscope->opencl;
+
+	switch (opencl->memory) {
+	case SINOSCOPE_OPENCL_MEMORY_COPY:
+		*output = opencl->buffer;
+		return 0;
+	case SINOSCOPE_OPENCL_MEMORY_ALLOC_HOST:
+		*output = opencl->mapped;
+		return 0;
+	case SINOSCOPE_OPENCL_MEMORY_USE_HOST:
+		break;
+	}
+
+	/* the frame ring and the async handler rotate the sinoscope buffer, each keeps its wrapper */
+	for (unsigned int w = 0; w < SINOSCOPE_OPENCL_WRAPPERS; w++) {
+		if (opencl->wrappers[w].host == sinoscope->buffer) {
+			*output = opencl->wrappers[w].buffer;
+			return 0;
+		}
+	}
+
+	sinoscope_opencl_wrapper_t* wrapper = &opencl->wrappers[opencl->next_wrapper];
+	opencl->next_wrapper = (opencl->next_wrapper + 1) % SINOSCOPE_OPENCL_WRAPPERS;
+
+	if (wrapper->buffer != NULL) {
+		clReleaseMemObject(wrapper->buffer);
+		wrapper->buffer = NULL;
+		wrapper->host   = NULL;
+	}
+
+	cl_int error;
+	cl_mem buffer = clCreateBuffer(opencl->context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, sinoscope->buffer_size,
+				       sinoscope->buffer, &error);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to create OpenCL buffer: %d", error);
+		return -1;
+	}
+
+	wrapper->host   = sinoscope->buffer;
+	wrapper->buffer = buffer;
+
+	*output = buffer;
+	return 0;
+}
+
+/* waits for the kernels writing `output` and brings the frame into the sinoscope buffer */
+static int read_output(sinoscope_t* sinoscope, cl_mem output) {
+	sinoscope_opencl_t* opencl = sinoscope->opencl;
+	cl_int error;
+
+	cl_event event;
+
+	if (opencl->memory == SINOSCOPE_OPENCL_MEMORY_COPY) {
+		error = clEnqueueReadBuffer(opencl->queue, output, CL_TRUE, 0, sinoscope->buffer_size, sinoscope->buffer, 0, NULL,
+					    profiled(opencl, &event));
+		if (error != CL_SUCCESS) {
+			LOG_ERROR("Failed to read buffer: %d", error);
+			return -1;
+		}
+
+		record_event(sinoscope, SINOSCOPE_PHASE_READBACK, event);
+		return 0;
+	}
+
+	unsigned char* frame = clEnqueueMapBuffer(opencl->queue, output, CL_TRUE, CL_MAP_READ, 0, sinoscope->buffer_size, 0,
+						  NULL, profiled(opencl, &event), &error);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to map buffer: %d", error);
+		return -1;
+	}
+
+	record_event(sinoscope, SINOSCOPE_PHASE_READBACK, event);
+
+	/* with use-host the runtime may hand back the sinoscope buffer itself */
+	if (frame != sinoscope->buffer) {
+		struct timespec copy_start;
+		clock_gettime(CLOCK_MONOTONIC, &copy_start);
+
+		memcpy(sinoscope->buffer, frame, sinoscope->buffer_size);
+		record_host(sinoscope, SINOSCOPE_PHASE_READBACK, &copy_start);
+	}
+
+	error = clEnqueueUnmapMemObject(opencl->queue, output, frame, 0, NULL, NULL);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to unmap buffer: %d", error);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* arguments that only change with the taylor degree, the palette interval or the frame size */
+static int set_static_args(sinoscope_t* sinoscope) {
+	sinoscope_opencl_t* opencl = sinoscope->opencl;
+
+	if (sinoscope->precision != opencl->precision) {
+		LOG_ERROR("OpenCL context built for precision `%s`, not `%s`", sinoscope_precision_name(opencl->precision),
+			  sinoscope_precision_name(sinoscope->precision));
+		return -1;
+	}
+
+	if (opencl->args_taylor == sinoscope->taylor && opencl->args_interval == sinoscope->interval &&
+	    opencl->args_width == sinoscope->width && opencl->args_height == sinoscope->height &&
+	    opencl->args_pixel_size == sinoscope->pixel_size) {
+		return 0;
+	}
 
 	modified_sinoscope_t mod_sinoscope;
 	mod_sinoscope.buffer_size = sinoscope->buffer_size;
@@ -90,43 +584,492 @@ int sinoscope_image_opencl(sinoscope_t* sinoscope) {
 	mod_sinoscope.height = sinoscope->height;
 	mod_sinoscope.taylor = sinoscope->taylor;
 	mod_sinoscope.interval = sinoscope->interval;
+	mod_sinoscope.pixel_size = sinoscope->pixel_size;
 
-	error = clSetKernelArg(sinoscope->opencl->kernel, 0, sizeof(cl_mem), &(sinoscope->opencl->buffer));
-	error |= clSetKernelArg(sinoscope->opencl->kernel, 1, sizeof(modified_sinoscope_t), &mod_sinoscope);
-	error |= clSetKernelArg(sinoscope->opencl->kernel, 2, sizeof(float), &(sinoscope->interval_inverse));
-	error |= clSetKernelArg(sinoscope->opencl->kernel, 3, sizeof(float), &(sinoscope->time));
-	error |= clSetKernelArg(sinoscope->opencl->kernel, 4, sizeof(float), &(sinoscope->max));
-	error |= clSetKernelArg(sinoscope->opencl->kernel, 5, sizeof(float), &(sinoscope->phase0));
-	error |= clSetKernelArg(sinoscope->opencl->kernel, 6, sizeof(float), &(sinoscope->phase1));
-	error |= clSetKernelArg(sinoscope->opencl->kernel, 7, sizeof(float), &(sinoscope->dx));
-	error |= clSetKernelArg(sinoscope->opencl->kernel, 8, sizeof(float), &(sinoscope->dy));
+	cl_int error = clSetKernelArg(opencl->kernel, 1, sizeof(modified_sinoscope_t), &mod_sinoscope);
+	error |= clSetKernelArg(opencl->kernel, 2, sizeof(float), &(sinoscope->interval_inverse));
+	error |= clSetKernelArg(opencl->kernel, 4, sizeof(float), &(sinoscope->max));
+	error |= clSetKernelArg(opencl->kernel, 7, sizeof(float), &(sinoscope->dx));
+	error |= clSetKernelArg(opencl->kernel, 8, sizeof(float), &(sinoscope->dy));
 
-	if(error != CL_SUCCESS) {
+	error |= clSetKernelArg(opencl->strip_kernel, 1, sizeof(modified_sinoscope_t), &mod_sinoscope);
+	error |= clSetKernelArg(opencl->strip_kernel, 2, sizeof(float), &(sinoscope->interval_inverse));
+	error |= clSetKernelArg(opencl->strip_kernel, 4, sizeof(float), &(sinoscope->max));
+	error |= clSetKernelArg(opencl->strip_kernel, 7, sizeof(float), &(sinoscope->dx));
+	error |= clSetKernelArg(opencl->strip_kernel, 8, sizeof(float), &(sinoscope->dy));
+
+	error |= clSetKernelArg(opencl->terms_kernel, 1, sizeof(modified_sinoscope_t), &mod_sinoscope);
+	error |= clSetKernelArg(opencl->terms_kernel, 5, sizeof(float), &(sinoscope->dx));
+	error |= clSetKernelArg(opencl->terms_kernel, 6, sizeof(float), &(sinoscope->dy));
+
+	error |= clSetKernelArg(opencl->separable_kernel, 2, sizeof(modified_sinoscope_t), &mod_sinoscope);
+	error |= clSetKernelArg(opencl->separable_kernel, 3, sizeof(float), &(sinoscope->interval_inverse));
+
+	if (error != CL_SUCCESS) {
 		LOG_ERROR("Failed to set OpenCL kernel arguments: %d", error);
+		return -1;
+	}
+
+	opencl->args_taylor = sinoscope->taylor;
+	opencl->args_interval = sinoscope->interval;
+	opencl->args_width = sinoscope->width;
+	opencl->args_height = sinoscope->height;
+	opencl->args_pixel_size = sinoscope->pixel_size;
+	return 0;
+}
+
+/* the image and strip kernels take the same arguments */
+static int set_frame_args(sinoscope_t* sinoscope, cl_kernel kernel, cl_mem buffer) {
+	if (upload_palette(sinoscope) < 0 || set_static_args(sinoscope) < 0) {
+		return -1;
+	}
+
+	cl_int error = clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer);
+	error |= clSetKernelArg(kernel, 3, sizeof(float), &(sinoscope->time));
+	error |= clSetKernelArg(kernel, 5, sizeof(float), &(sinoscope->phase0));
+	error |= clSetKernelArg(kernel, 6, sizeof(float), &(sinoscope->phase1));
+
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to set OpenCL kernel arguments: %d", error);
+		return -1;
+	}
+
+	return 0;
+}
+
+int sinoscope_image_opencl(sinoscope_t* sinoscope) {
+	if (sinoscope == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+	cl_int error = 0;
+
+	/* a frame left by the async handler would complete on top of this one */
+	if (sinoscope_opencl_drain(sinoscope) < 0) {
+		goto fail_exit;
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	cl_mem output;
+	if (output_buffer(sinoscope, &output) < 0) {
+		goto fail_exit;
+	}
+
+	if (set_frame_args(sinoscope, sinoscope->opencl->kernel, output) < 0) {
 		goto fail_exit;
 	}
 
+	cl_event kernel_event;
 	const size_t total_size = sinoscope->width * sinoscope->height;
-	error = clEnqueueNDRangeKernel(sinoscope->opencl->queue, sinoscope->opencl->kernel, 1, NULL, &total_size, NULL, 0, NULL, NULL);
+	error = clEnqueueNDRangeKernel(sinoscope->opencl->queue, sinoscope->opencl->kernel, 1, NULL, &total_size, NULL, 0, NULL,
+				       profiled(sinoscope->opencl, &kernel_event));
 	if(error != CL_SUCCESS) {
 		LOG_ERROR("Failed to start OpenCL kernel threads: %d", error);
 		goto fail_exit;
 	}
 
-    error = clEnqueueReadBuffer(sinoscope->opencl->queue, sinoscope->opencl->buffer, CL_TRUE, 0, sinoscope->buffer_size, sinoscope->buffer, 0 , NULL, NULL);
-    if (error != CL_SUCCESS) {
-        LOG_ERROR("Failed to read buffer: %d", error);
-        goto fail_exit;
-    }
-	
-	error = clFinish(sinoscope->opencl->queue);
-    if (error != CL_SUCCESS) {
-        LOG_ERROR("Failed to wait finish OpenCL kernel: %d", error);
-        goto fail_exit;
-    }
+	record_host(sinoscope, SINOSCOPE_PHASE_ENQUEUE, &start);
+
+	/* the blocking read or map already waits for the kernel on the in-order queue */
+	int status = read_output(sinoscope, output);
+	record_event(sinoscope, SINOSCOPE_PHASE_KERNEL, kernel_event);
+
+	if (status < 0) {
+		goto fail_exit;
+	}
+
+	return 0;
+
+fail_exit:
+	return -1;
+}
+
+int sinoscope_image_opencl_2d(sinoscope_t* sinoscope) {
+	if (sinoscope == NULL) {
+		LOG_ERROR_NULL_PTR();
+		goto fail_exit;
+	}
+	cl_int error = 0;
+
+	if (sinoscope_opencl_drain(sinoscope) < 0) {
+		goto fail_exit;
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	cl_mem output;
+	if (output_buffer(sinoscope, &output) < 0) {
+		goto fail_exit;
+	}
+
+	if (set_frame_args(sinoscope, sinoscope->opencl->strip_kernel, output) < 0) {
+		goto fail_exit;
+	}
+
+	cl_event kernel_event;
+	error = enqueue_strip(sinoscope->opencl, sinoscope->width, sinoscope->height, profiled(sinoscope->opencl, &kernel_event));
+	if(error != CL_SUCCESS) {
+		LOG_ERROR("Failed to start OpenCL kernel threads: %d", error);
+		goto fail_exit;
+	}
+
+	record_host(sinoscope, SINOSCOPE_PHASE_ENQUEUE, &start);
+
+	int status = read_output(sinoscope, output);
+	record_event(sinoscope, SINOSCOPE_PHASE_KERNEL, kernel_event);
+
+	if (status < 0) {
+		goto fail_exit;
+	}
+
+	return 0;
+
+fail_exit:
+	return -1;
+}
+
+int sinoscope_image_opencl_separable(sinoscope_t* sinoscope) {
+	if (sinoscope == NULL) {
+		LOG_ERROR_NULL_PTR();
+		goto fail_exit;
+	}
+	cl_int error = 0;
+	sinoscope_opencl_t* opencl = sinoscope->opencl;
+
+	if (sinoscope_opencl_drain(sinoscope) < 0) {
+		goto fail_exit;
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (upload_palette(sinoscope) < 0 || set_static_args(sinoscope) < 0) {
+		goto fail_exit;
+	}
+
+	cl_mem output;
+	if (output_buffer(sinoscope, &output) < 0) {
+		goto fail_exit;
+	}
+
+	error = clSetKernelArg(opencl->separable_kernel, 0, sizeof(cl_mem), &output);
+	error |= clSetKernelArg(opencl->terms_kernel, 2, sizeof(float), &(sinoscope->time));
+	error |= clSetKernelArg(opencl->terms_kernel, 3, sizeof(float), &(sinoscope->phase0));
+	error |= clSetKernelArg(opencl->terms_kernel, 4, sizeof(float), &(sinoscope->phase1));
+
+	if(error != CL_SUCCESS) {
+		LOG_ERROR("Failed to set OpenCL kernel arguments: %d", error);
+		goto fail_exit;
+	}
+
+	/* the queue is in-order, the image kernel sees the complete series */
+	cl_event terms_event;
+	const size_t terms_size = sinoscope->width + sinoscope->height;
+	error = clEnqueueNDRangeKernel(opencl->queue, opencl->terms_kernel, 1, NULL, &terms_size, NULL, 0, NULL,
+				       profiled(opencl, &terms_event));
+	if(error != CL_SUCCESS) {
+		LOG_ERROR("Failed to start OpenCL kernel threads: %d", error);
+		goto fail_exit;
+	}
+
+	cl_event image_event;
+	const size_t image_size[2] = {sinoscope->width, sinoscope->height};
+	error = clEnqueueNDRangeKernel(opencl->queue, opencl->separable_kernel, 2, NULL, image_size, NULL, 0, NULL,
+				       profiled(opencl, &image_event));
+	if(error != CL_SUCCESS) {
+		LOG_ERROR("Failed to start OpenCL kernel threads: %d", error);
+		if (terms_event != NULL) {
+			clReleaseEvent(terms_event);
+		}
+		goto fail_exit;
+	}
+
+	record_host(sinoscope, SINOSCOPE_PHASE_ENQUEUE, &start);
+
+	int status = read_output(sinoscope, output);
+	record_event(sinoscope, SINOSCOPE_PHASE_KERNEL, terms_event);
+	record_event(sinoscope, SINOSCOPE_PHASE_KERNEL, image_event);
+
+	if (status < 0) {
+		goto fail_exit;
+	}
+
+	return 0;
+
+fail_exit:
+	return -1;
+}
+
+/* waits for the readback of `slot` and swaps its host buffer with the sinoscope one */
+static int complete_frame(sinoscope_t* sinoscope, unsigned int slot) {
+	sinoscope_opencl_t* opencl = sinoscope->opencl;
+
+	cl_int error = clWaitForEvents(1, &opencl->read_events[slot]);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to wait for OpenCL readback: %d", error);
+		return -1;
+	}
+
+	/* the kernel finished before the readback it gates */
+	record_event(sinoscope, SINOSCOPE_PHASE_KERNEL, opencl->kernel_events[slot]);
+	record_event(sinoscope, SINOSCOPE_PHASE_READBACK, opencl->read_events[slot]);
+	opencl->kernel_events[slot] = NULL;
+	opencl->read_events[slot] = NULL;
+
+	/* every buffer has the sinoscope buffer size, ownership just rotates */
+	unsigned char* completed = opencl->host_buffers[slot];
+	opencl->host_buffers[slot] = sinoscope->buffer;
+	sinoscope->buffer = completed;
+
+	return 0;
+}
+
+int sinoscope_opencl_drain(sinoscope_t* sinoscope) {
+	if (sinoscope == NULL || sinoscope->opencl == NULL) {
+		return 0;
+	}
+
+	sinoscope_opencl_t* opencl = sinoscope->opencl;
+	if (opencl->in_flight < 0) {
+		return 0;
+	}
+
+	int slot = opencl->in_flight;
+	opencl->in_flight = -1;
+
+	return complete_frame(sinoscope, slot);
+}
+
+/*
+ * Frame N is computed in the slot not used by frame N-1, whose readback runs
+ * on the transfer queue at the same time. The sinoscope buffer holds frame
+ * N-1 on return. The first frame, and the first after a drain, is waited
+ * for, so every call hands a completed frame to the sinoscope buffer.
+ */
+int sinoscope_image_opencl_async(sinoscope_t* sinoscope) {
+	if (sinoscope == NULL) {
+		LOG_ERROR_NULL_PTR();
+		goto fail_exit;
+	}
+	cl_int error = 0;
+	sinoscope_opencl_t* opencl = sinoscope->opencl;
+
+	for (int i = 0; i < 2; i++) {
+		if (opencl->host_buffers[i] == NULL) {
+			/* the buffers are swapped with the sinoscope one */
+			opencl->host_buffers[i] = sinoscope_alloc_buffer(sinoscope->buffer_size);
+			if (opencl->host_buffers[i] == NULL) {
+				LOG_ERROR("failed to allocate async host buffer");
+				goto fail_exit;
+			}
+		}
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	unsigned int slot = opencl->next_slot;
+	cl_mem buffer = (slot == 0) ? opencl->buffer : opencl->back_buffer;
+
+	if (set_frame_args(sinoscope, opencl->kernel, buffer) < 0) {
+		goto fail_exit;
+	}
+
+	/* the device buffer may still be read back by the frame before the previous one */
+	cl_uint wait_count = (opencl->read_events[slot] != NULL) ? 1 : 0;
+	cl_event kernel_event;
+
+	const size_t total_size = sinoscope->width * sinoscope->height;
+	error = clEnqueueNDRangeKernel(opencl->queue, opencl->kernel, 1, NULL, &total_size, NULL, wait_count,
+				       wait_count ? &opencl->read_events[slot] : NULL, &kernel_event);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to start OpenCL kernel threads: %d", error);
+		goto fail_exit;
+	}
+
+	if (opencl->read_events[slot] != NULL) {
+		clReleaseEvent(opencl->read_events[slot]);
+		opencl->read_events[slot] = NULL;
+	}
+
+	if (opencl->kernel_events[slot] != NULL) {
+		clReleaseEvent(opencl->kernel_events[slot]);
+		opencl->kernel_events[slot] = NULL;
+	}
+
+	error = clEnqueueReadBuffer(opencl->transfer_queue, buffer, CL_FALSE, 0, sinoscope->buffer_size,
+				    opencl->host_buffers[slot], 1, &kernel_event, &opencl->read_events[slot]);
+
+	/* timed once the frame completes, the phases of a call are those of the frame it returns */
+	if (opencl->profiling && error == CL_SUCCESS) {
+		opencl->kernel_events[slot] = kernel_event;
+	} else {
+		clReleaseEvent(kernel_event);
+	}
+
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to read buffer: %d", error);
+		goto fail_exit;
+	}
+
+	clFlush(opencl->queue);
+	clFlush(opencl->transfer_queue);
+	record_host(sinoscope, SINOSCOPE_PHASE_ENQUEUE, &start);
+
+	int previous = opencl->in_flight;
+	opencl->in_flight = slot;
+	opencl->next_slot = 1 - slot;
+
+	if (previous < 0) {
+		return sinoscope_opencl_drain(sinoscope);
+	}
+
+	if (complete_frame(sinoscope, previous) < 0) {
+		goto fail_exit;
+	}
 
 	return 0;
 
 fail_exit:
 	return -1;
-}
\ No newline at end of file
+}
+
+typedef struct hybrid_completion {
+	struct timespec end;
+	int done;
+} hybrid_completion_t;
+
+static void CL_CALLBACK hybrid_device_done(cl_event event, cl_int status, void* data) {
+	hybrid_completion_t* completion = data;
+
+	clock_gettime(CLOCK_MONOTONIC, &completion->end);
+	__atomic_store_n(&completion->done, 1, __ATOMIC_RELEASE);
+}
+
+static unsigned int hybrid_split(float share, unsigned int height) {
+	unsigned int split = share * height + 0.5f;
+
+	if (split < 1) {
+		split = 1;
+	}
+	if (split >= height && height > 1) {
+		split = height - 1;
+	}
+
+	return split;
+}
+
+/*
+ * The first rows of the frame are rendered by the device while the OpenMP
+ * threads render the others into the same buffer. The device share moves
+ * towards the throughput measured on both sides, so that they finish
+ * together on the next frame.
+ */
+int sinoscope_image_opencl_hybrid(sinoscope_t* sinoscope) {
+	if (sinoscope == NULL) {
+		LOG_ERROR_NULL_PTR();
+		goto fail_exit;
+	}
+	cl_int error = 0;
+	sinoscope_opencl_t* opencl = sinoscope->opencl;
+
+	if (sinoscope_opencl_drain(sinoscope) < 0) {
+		goto fail_exit;
+	}
+
+	struct timespec enqueue_start;
+	clock_gettime(CLOCK_MONOTONIC, &enqueue_start);
+
+	/* the readback goes straight into the sinoscope buffer, whatever the memory mode */
+	if (set_frame_args(sinoscope, opencl->kernel, opencl->buffer) < 0) {
+		goto fail_exit;
+	}
+
+	const unsigned int split = hybrid_split(opencl->hybrid_share, sinoscope->height);
+	const size_t device_size = (size_t)split * sinoscope->width;
+
+	struct timespec start, host_end;
+	hybrid_completion_t completion = {.done = 0};
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	cl_event kernel_event;
+	error = clEnqueueNDRangeKernel(opencl->queue, opencl->kernel, 1, NULL, &device_size, NULL, 0, NULL,
+				       profiled(opencl, &kernel_event));
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to start OpenCL kernel threads: %d", error);
+		goto fail_exit;
+	}
+
+	cl_event read_event;
+	error = clEnqueueReadBuffer(opencl->queue, opencl->buffer, CL_FALSE, 0, device_size * sinoscope->pixel_size, sinoscope->buffer, 0,
+				    NULL, &read_event);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to read buffer: %d", error);
+		goto fail_release_kernel_event;
+	}
+
+	error = clSetEventCallback(read_event, CL_COMPLETE, hybrid_device_done, &completion);
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to set OpenCL event callback: %d", error);
+		clWaitForEvents(1, &read_event);
+		clReleaseEvent(read_event);
+		goto fail_release_kernel_event;
+	}
+
+	clFlush(opencl->queue);
+	record_host(sinoscope, SINOSCOPE_PHASE_ENQUEUE, &enqueue_start);
+
+	int status = sinoscope_openmp_render_rows(sinoscope, split, sinoscope->height);
+	clock_gettime(CLOCK_MONOTONIC, &host_end);
+
+	error = clWaitForEvents(1, &read_event);
+	record_event(sinoscope, SINOSCOPE_PHASE_KERNEL, kernel_event);
+	record_event(sinoscope, SINOSCOPE_PHASE_READBACK, read_event);
+
+	/* the callback may run after the wait returns, it writes to the stack of this frame */
+	while (!__atomic_load_n(&completion.done, __ATOMIC_ACQUIRE)) {
+		sched_yield();
+	}
+
+	if (error != CL_SUCCESS) {
+		LOG_ERROR("Failed to wait for OpenCL readback: %d", error);
+		goto fail_exit;
+	}
+
+	if (status < 0) {
+		LOG_ERROR("Failed to render host rows");
+		goto fail_exit;
+	}
+
+	double device_time = (completion.end.tv_sec - start.tv_sec) + (completion.end.tv_nsec - start.tv_nsec) * 1e-9;
+	double host_time = (host_end.tv_sec - start.tv_sec) + (host_end.tv_nsec - start.tv_nsec) * 1e-9;
+
+	if (device_time > 0 && host_time > 0 && split < sinoscope->height) {
+		double device_rate = split / device_time;
+		double host_rate = (sinoscope->height - split) / host_time;
+		float share = device_rate / (device_rate + host_rate);
+
+		/* half way to the measured share, a single noisy frame does not swing the split */
+		share = (opencl->hybrid_share + share) / 2;
+		if (share < HYBRID_MIN_SHARE) {
+			share = HYBRID_MIN_SHARE;
+		}
+		if (share > 1 - HYBRID_MIN_SHARE) {
+			share = 1 - HYBRID_MIN_SHARE;
+		}
+
+		opencl->hybrid_share = share;
+	}
+
+	return 0;
+
+fail_release_kernel_event:
+	if (kernel_event != NULL) {
+		clReleaseEvent(kernel_event);
+	}
+fail_exit:
+	return -1;
+}
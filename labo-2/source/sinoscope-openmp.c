@@ -1,50 +1,740 @@
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <omp.h>
 
 #include "color.h"
 #include "log.h"
+#include "sinoscope-precision.h"
 #include "sinoscope.h"
 
+/* tiles wider than this would not fit the per-thread value buffer */
+static const unsigned int TILE_WIDTH_MAX = 4096;
+/* granularity of the NUMA placement */
+static const size_t FIRST_TOUCH_PAGE = 4096;
+
+static omp_sched_t tiled_schedule = omp_sched_static;
+static int tiled_chunk            = 0;
+static unsigned int tiled_width   = 128;
+static unsigned int tiled_height  = 8;
+
+/* thread count given to sinoscope_openmp_set_threads, zero until the first call */
+static int openmp_threads = 0;
+
+/* the thread count is a per-thread setting like the schedule, the handlers may run outside of main */
+static void apply_threads(void) {
+    if (openmp_threads > 0) {
+        omp_set_num_threads(openmp_threads);
+    }
+}
+
+/* the series loops end on a barrier, the time of the master thread splits the frame */
+static void record_phases(sinoscope_t* sinoscope, double start, double series, double end) {
+    if (!sinoscope_profile) {
+        return;
+    }
+
+    sinoscope->phases[SINOSCOPE_PHASE_COMPUTE]  = (series - start) * 1e6;
+    sinoscope->phases[SINOSCOPE_PHASE_COLORIZE] = (end - series) * 1e6;
+}
+
+/* `precision` is a constant in every call, each one is compiled with the arithmetic of its precision */
+static inline __attribute__((always_inline)) void render(sinoscope_t* sinoscope, sinoscope_precision_t precision) {
+    int i, j, index;
+    float value;
+    const pixel_t* pixel;
+
+	// Changer le nbr de tour de boucle par thread pour optimiser l'accès mémoire
+	#pragma omp parallel for schedule(static) private(i, j, index, pixel, value) shared(sinoscope)
+    for (j = 0; j < sinoscope->height; j++) {
+        for (i = 0; i < sinoscope->width; i++) {
+            value = sinoscope_precision_value(sinoscope, i, j, precision);
+
+            pixel = color_lookup(sinoscope->palette, value);
+
+            index = i + j * sinoscope->width;
+
+            sinoscope_store_pixel(sinoscope->buffer, index, pixel, sinoscope->format);
+        }
+    }
+}
+
 int sinoscope_image_openmp(sinoscope_t* sinoscope) {
 	if (sinoscope == NULL) {
         LOG_ERROR_NULL_PTR();
         goto fail_exit;
     }
 
-    int i, j, k, index;
-    float px, py, value;
-    pixel_t pixel;
+    apply_threads();
 
-	// Changer le nbr de tour de boucle par thread pour optimiser l'accès mémoire
-	#pragma omp parallel for schedule(static) private(i, j, k, index, px, py, pixel, value) shared(sinoscope)
-    for (j = 0; j < sinoscope->height; j++) {
-        for (i = 0; i < sinoscope->width; i++) {
-            px    = sinoscope->dx * j - 2 * M_PI;
-            py    = sinoscope->dy * i - 2 * M_PI;
-            value = 0;
+    switch (sinoscope->precision) {
+    case SINOSCOPE_PRECISION_DOUBLE:
+        render(sinoscope, SINOSCOPE_PRECISION_DOUBLE);
+        break;
+    case SINOSCOPE_PRECISION_FLOAT:
+        render(sinoscope, SINOSCOPE_PRECISION_FLOAT);
+        break;
+    case SINOSCOPE_PRECISION_NATIVE:
+        render(sinoscope, SINOSCOPE_PRECISION_NATIVE);
+        break;
+    default:
+        render(sinoscope, SINOSCOPE_PRECISION_DEFAULT);
+        break;
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+
+int sinoscope_image_openmp_separable(sinoscope_t* sinoscope) {
+    if (sinoscope == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    apply_threads();
 
-            for (k = 1; k <= sinoscope->taylor; k += 2) {
+    float* columns = malloc((sinoscope->width + sinoscope->height) * sizeof(*columns));
+    if (columns == NULL) {
+        LOG_ERROR_ERRNO("malloc");
+        goto fail_exit;
+    }
+
+    float* rows = columns + sinoscope->width;
+
+    double start = omp_get_wtime();
+    double series, end;
+
+    #pragma omp parallel shared(sinoscope, columns, rows, series, end)
+    {
+        /* the two tables are independent, no barrier needed between them */
+        #pragma omp for schedule(static) nowait
+        for (int i = 0; i < sinoscope->width; i++) {
+            float py    = sinoscope->dy * i - 2 * M_PI;
+            float value = 0;
+
+            for (int k = 1; k <= sinoscope->taylor; k += 2) {
+                value += cos(py * k * sinoscope->phase0) / k;
+            }
+
+            columns[i] = value;
+        }
+
+        #pragma omp for schedule(static)
+        for (int j = 0; j < sinoscope->height; j++) {
+            float px    = sinoscope->dx * j - 2 * M_PI;
+            float value = 0;
+
+            for (int k = 1; k <= sinoscope->taylor; k += 2) {
                 value += sin(px * k * sinoscope->phase1 + sinoscope->time) / k;
+            }
+
+            rows[j] = value;
+        }
+
+        #pragma omp master
+        series = omp_get_wtime();
+
+        #pragma omp for schedule(static)
+        for (int j = 0; j < sinoscope->height; j++) {
+            for (int i = 0; i < sinoscope->width; i++) {
+                float value = rows[j] + columns[i];
+
+                value = (atan(value) - atan(-value)) / M_PI;
+                value = (value + 1) * 100;
+
+                const pixel_t* pixel = color_lookup(sinoscope->palette, value);
+
+                sinoscope_store_pixel(sinoscope->buffer, i + j * sinoscope->width, pixel, sinoscope->format);
+            }
+        }
+
+        #pragma omp master
+        end = omp_get_wtime();
+    }
+
+    record_phases(sinoscope, start, series, end);
+    free(columns);
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+/* largest |step * index - 2 pi| over `count` indices, the coordinate multiplied by the phase */
+static float series_extent(float step, unsigned int count) {
+    float last = fabsf(step * (count > 0 ? count - 1 : 0) - 2 * M_PI);
+
+    return last > 2 * M_PI ? last : 2 * M_PI;
+}
+
+/* largest change of the coordinate * k * phase over the series */
+static float series_drift(unsigned int taylor, float extent, float cached, float current) {
+    return extent * taylor * fabsf(current - cached);
+}
+
+/* slot remembering what was drawn into `buffer`, an unknown buffer takes the oldest slot */
+static sinoscope_cache_slot_t* cache_slot(sinoscope_cache_t* cache, const unsigned char* buffer) {
+    for (unsigned int s = 0; s < SINOSCOPE_CACHE_SLOTS; s++) {
+        if (cache->slots[s].buffer == buffer) {
+            return &cache->slots[s];
+        }
+    }
+
+    sinoscope_cache_slot_t* slot = &cache->slots[cache->next_slot];
+    cache->next_slot             = (cache->next_slot + 1) % SINOSCOPE_CACHE_SLOTS;
+
+    slot->buffer  = buffer;
+    slot->columns = 0;
+    slot->frame   = 0;
+
+    return slot;
+}
+
+/*
+ * Separable rendering that keeps both series across frames. The cache
+ * remembers what was drawn into each buffer, so that the frame ring and
+ * the async handler rotating buffers still skip work: a buffer already
+ * holding the current series is left untouched, otherwise only its rows
+ * whose sum changed are drawn, or every row when the columns changed.
+ */
+int sinoscope_image_openmp_cached(sinoscope_t* sinoscope) {
+    if (sinoscope == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    apply_threads();
+
+    sinoscope_cache_t* cache = &sinoscope->cache;
+
+    if (cache->columns == NULL) {
+        const size_t floats = sinoscope->width + (1 + SINOSCOPE_CACHE_SLOTS) * (size_t)sinoscope->height;
+
+        cache->columns = malloc(floats * sizeof(float) + sinoscope->height);
+        if (cache->columns == NULL) {
+            LOG_ERROR_ERRNO("malloc");
+            goto fail_exit;
+        }
+
+        cache->rows = cache->columns + sinoscope->width;
+
+        for (unsigned int s = 0; s < SINOSCOPE_CACHE_SLOTS; s++) {
+            cache->slots[s].rows = cache->rows + (1 + s) * sinoscope->height;
+        }
+
+        cache->dirty = (unsigned char*)(cache->columns + floats);
+    }
+
+    const float tolerance = sinoscope_reuse_tolerance;
+    const bool taylor     = cache->taylor != sinoscope->taylor;
+
+    /* py spans the columns and px the rows, both reach 3 pi times the aspect ratio minus 2 pi */
+    const float column_extent = series_extent(sinoscope->dy, sinoscope->width);
+    const float row_extent    = series_extent(sinoscope->dx, sinoscope->height);
+    const float column_drift  = series_drift(sinoscope->taylor, column_extent, cache->phase0, sinoscope->phase0);
+    const float row_drift     = series_drift(sinoscope->taylor, row_extent, cache->phase1, sinoscope->phase1) +
+                                fabsf(sinoscope->time - cache->time);
+
+    const bool columns_stale = !cache->columns_valid || taylor || column_drift > tolerance;
+    const bool rows_stale    = !cache->rows_valid || taylor || row_drift > tolerance;
+
+    if (columns_stale) {
+        cache->columns_generation++;
+    }
+
+    if (columns_stale || rows_stale) {
+        cache->frame_generation++;
+    }
+
+    sinoscope_cache_slot_t* slot = cache_slot(cache, sinoscope->buffer);
+
+    if (slot->frame == cache->frame_generation) {
+        return 0;
+    }
+
+    /* the buffer was drawn with other columns, or never, every row is drawn */
+    const bool redraw = slot->columns != cache->columns_generation;
+
+    float* columns       = cache->columns;
+    float* rows          = cache->rows;
+    float* drawn         = slot->rows;
+    unsigned char* dirty = cache->dirty;
+
+    double start = omp_get_wtime();
+    double series, end;
+
+    #pragma omp parallel shared(sinoscope, columns, rows, drawn, dirty, series, end)
+    {
+        if (columns_stale) {
+            #pragma omp for schedule(static) nowait
+            for (int i = 0; i < sinoscope->width; i++) {
+                float py    = sinoscope->dy * i - 2 * M_PI;
+                float value = 0;
+
+                for (int k = 1; k <= sinoscope->taylor; k += 2) {
+                    value += cos(py * k * sinoscope->phase0) / k;
+                }
+
+                columns[i] = value;
+            }
+        }
+
+        /* the barrier of this loop also completes the columns */
+        #pragma omp for schedule(static)
+        for (int j = 0; j < sinoscope->height; j++) {
+            if (rows_stale) {
+                float px    = sinoscope->dx * j - 2 * M_PI;
+                float value = 0;
+
+                for (int k = 1; k <= sinoscope->taylor; k += 2) {
+                    value += sin(px * k * sinoscope->phase1 + sinoscope->time) / k;
+                }
+
+                rows[j] = value;
+            }
+
+            dirty[j] = redraw || drawn[j] != rows[j];
+            drawn[j] = rows[j];
+        }
+
+        #pragma omp master
+        series = omp_get_wtime();
+
+        #pragma omp for schedule(static)
+        for (int j = 0; j < sinoscope->height; j++) {
+            if (!dirty[j]) {
+                continue;
+            }
+
+            for (int i = 0; i < sinoscope->width; i++) {
+                float value = rows[j] + columns[i];
+
+                value = (atan(value) - atan(-value)) / M_PI;
+                value = (value + 1) * 100;
+
+                const pixel_t* pixel = color_lookup(sinoscope->palette, value);
+
+                int index = (i * 3) + (j * 3) * sinoscope->width;
+
+                sinoscope->buffer[index + 0] = pixel->bytes[0];
+                sinoscope->buffer[index + 1] = pixel->bytes[1];
+                sinoscope->buffer[index + 2] = pixel->bytes[2];
+            }
+        }
+
+        #pragma omp master
+        end = omp_get_wtime();
+    }
+
+    record_phases(sinoscope, start, series, end);
+
+    if (columns_stale) {
+        cache->phase0        = sinoscope->phase0;
+        cache->columns_valid = true;
+    }
+
+    if (rows_stale) {
+        cache->phase1     = sinoscope->phase1;
+        cache->time       = sinoscope->time;
+        cache->rows_valid = true;
+    }
+
+    cache->taylor = sinoscope->taylor;
+    slot->columns = cache->columns_generation;
+    slot->frame   = cache->frame_generation;
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+int sinoscope_openmp_render_batch(sinoscope_t* sinoscope, const sinoscope_frame_t* frames, unsigned char** buffers,
+                                  unsigned int count) {
+    if (sinoscope == NULL || frames == NULL || buffers == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    apply_threads();
+
+    const int width  = sinoscope->width;
+    const int height = sinoscope->height;
+
+    /* the column series of every frame, the rows are summed per frame and row */
+    float* columns = malloc((size_t)count * width * sizeof(*columns));
+    if (columns == NULL) {
+        LOG_ERROR_ERRNO("malloc");
+        goto fail_exit;
+    }
+
+    #pragma omp parallel shared(sinoscope, frames, buffers, columns)
+    {
+        #pragma omp for collapse(2) schedule(static)
+        for (int f = 0; f < count; f++) {
+            for (int i = 0; i < width; i++) {
+                float py    = sinoscope->dy * i - 2 * M_PI;
+                float value = 0;
+
+                for (int k = 1; k <= sinoscope->taylor; k += 2) {
+                    value += cos(py * k * frames[f].phase0) / k;
+                }
+
+                columns[f * width + i] = value;
+            }
+        }
+
+        #pragma omp for collapse(2) schedule(static)
+        for (int f = 0; f < count; f++) {
+            for (int j = 0; j < height; j++) {
+                float px  = sinoscope->dx * j - 2 * M_PI;
+                float row = 0;
+
+                for (int k = 1; k <= sinoscope->taylor; k += 2) {
+                    row += sin(px * k * frames[f].phase1 + frames[f].time) / k;
+                }
+
+                const float* frame_columns = &columns[f * width];
+                unsigned char* line        = &buffers[f][j * width * 3];
+
+                for (int i = 0; i < width; i++) {
+                    float value = row + frame_columns[i];
+
+                    value = (atan(value) - atan(-value)) / M_PI;
+                    value = (value + 1) * 100;
+
+                    const pixel_t* pixel = color_lookup(sinoscope->palette, value);
+
+                    line[i * 3 + 0] = pixel->bytes[0];
+                    line[i * 3 + 1] = pixel->bytes[1];
+                    line[i * 3 + 2] = pixel->bytes[2];
+                }
+            }
+        }
+    }
+
+    free(columns);
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+int sinoscope_openmp_render_rows(sinoscope_t* sinoscope, unsigned int first, unsigned int last) {
+    if (sinoscope == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    apply_threads();
+
+    const int width = sinoscope->width;
+
+    float* columns = malloc(width * sizeof(*columns));
+    if (columns == NULL) {
+        LOG_ERROR_ERRNO("malloc");
+        goto fail_exit;
+    }
+
+    #pragma omp parallel shared(sinoscope, columns)
+    {
+        #pragma omp for schedule(static)
+        for (int i = 0; i < width; i++) {
+            float py    = sinoscope->dy * i - 2 * M_PI;
+            float value = 0;
+
+            for (int k = 1; k <= sinoscope->taylor; k += 2) {
+                value += cos(py * k * sinoscope->phase0) / k;
+            }
+
+            columns[i] = value;
+        }
+
+        #pragma omp for schedule(static)
+        for (int j = first; j < (int)last; j++) {
+            float px  = sinoscope->dx * j - 2 * M_PI;
+            float row = 0;
+
+            for (int k = 1; k <= sinoscope->taylor; k += 2) {
+                row += sin(px * k * sinoscope->phase1 + sinoscope->time) / k;
+            }
+
+            unsigned char* line = &sinoscope->buffer[j * width * sinoscope->pixel_size];
+
+            for (int i = 0; i < width; i++) {
+                float value = row + columns[i];
+
+                value = (atan(value) - atan(-value)) / M_PI;
+                value = (value + 1) * 100;
+
+                const pixel_t* pixel = color_lookup(sinoscope->palette, value);
+
+                sinoscope_store_pixel(line, i, pixel, sinoscope->format);
+            }
+        }
+    }
+
+    free(columns);
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+int sinoscope_openmp_configure(const char* schedule, unsigned int chunk, unsigned int tile_width,
+                               unsigned int tile_height) {
+    if (schedule != NULL) {
+        if (strcmp(schedule, "static") == 0) {
+            tiled_schedule = omp_sched_static;
+        } else if (strcmp(schedule, "dynamic") == 0) {
+            tiled_schedule = omp_sched_dynamic;
+        } else if (strcmp(schedule, "guided") == 0) {
+            tiled_schedule = omp_sched_guided;
+        } else {
+            LOG_ERROR("unknown schedule `%s`", schedule);
+            goto fail_exit;
+        }
+    }
+
+    if (tile_width > TILE_WIDTH_MAX) {
+        LOG_ERROR("tile width %u is larger than %u", tile_width, TILE_WIDTH_MAX);
+        goto fail_exit;
+    }
+
+    /* zero keeps the current value, or the runtime default for the chunk */
+    tiled_chunk = chunk;
+
+    if (tile_width > 0) {
+        tiled_width = tile_width;
+    }
+
+    if (tile_height > 0) {
+        tiled_height = tile_height;
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+int sinoscope_openmp_set_threads(unsigned int threads) {
+    /* OMP_NUM_THREADS or the processor count, saved before the first change */
+    static int default_threads = 0;
+
+    if (default_threads == 0) {
+        default_threads = omp_get_max_threads();
+    }
+
+    openmp_threads = threads > 0 ? (int)threads : default_threads;
+    apply_threads();
+
+    return 0;
+}
+
+unsigned int sinoscope_openmp_max_threads(void) {
+    apply_threads();
+
+    return omp_get_max_threads();
+}
+
+/* rows of one tile, the thread time of both parts is added to `compute` and `colorize` when profiling */
+static void render_tile(sinoscope_t* sinoscope, unsigned int tile_x, unsigned int tile_y, unsigned int tile_width,
+                        unsigned int tile_height, bool profile, double* compute, double* colorize) {
+    unsigned int i_begin = tile_x * tile_width;
+    unsigned int j_begin = tile_y * tile_height;
+    unsigned int i_end   = i_begin + tile_width < sinoscope->width ? i_begin + tile_width : sinoscope->width;
+    unsigned int j_end   = j_begin + tile_height < sinoscope->height ? j_begin + tile_height : sinoscope->height;
+
+    double row_terms[sinoscope->taylor / 2 + 1];
+    float values[tile_width];
+
+    for (unsigned int j = j_begin; j < j_end; j++) {
+        double row_start = profile ? omp_get_wtime() : 0;
+
+        /* the sin term is shared by the whole row of the tile */
+        float px = sinoscope->dx * j - 2 * M_PI;
+
+        for (int k = 1; k <= sinoscope->taylor; k += 2) {
+            row_terms[k / 2] = sin(px * k * sinoscope->phase1 + sinoscope->time) / k;
+        }
+
+        #pragma omp simd
+        for (unsigned int i = i_begin; i < i_end; i++) {
+            float py    = sinoscope->dy * i - 2 * M_PI;
+            float value = 0;
+
+            for (int k = 1; k <= sinoscope->taylor; k += 2) {
+                value += row_terms[k / 2];
                 value += cos(py * k * sinoscope->phase0) / k;
             }
 
             value = (atan(value) - atan(-value)) / M_PI;
-            value = (value + 1) * 100;
+            values[i - i_begin] = (value + 1) * 100;
+        }
+
+        double row_values = profile ? omp_get_wtime() : 0;
+
+        unsigned char* line = &sinoscope->buffer[(j * sinoscope->width + i_begin) * 3];
+
+        for (unsigned int i = 0; i < i_end - i_begin; i++) {
+            const pixel_t* pixel = color_lookup(sinoscope->palette, values[i]);
+
+            line[i * 3 + 0] = pixel->bytes[0];
+            line[i * 3 + 1] = pixel->bytes[1];
+            line[i * 3 + 2] = pixel->bytes[2];
+        }
+
+        if (profile) {
+            *compute += row_values - row_start;
+            *colorize += omp_get_wtime() - row_values;
+        }
+    }
+}
 
-            color_value(&pixel, value, sinoscope->interval, sinoscope->interval_inverse);
+int sinoscope_image_openmp_tiled(sinoscope_t* sinoscope) {
+    if (sinoscope == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
 
-            index = (i * 3) + (j * 3) * sinoscope->width;
+    apply_threads();
 
-            sinoscope->buffer[index + 0] = pixel.bytes[0];
-            sinoscope->buffer[index + 1] = pixel.bytes[1];
-            sinoscope->buffer[index + 2] = pixel.bytes[2];
+    const unsigned int tile_width  = tiled_width;
+    const unsigned int tile_height = tiled_height;
+    const unsigned int tiles_x     = (sinoscope->width + tile_width - 1) / tile_width;
+    const unsigned int tiles_y     = (sinoscope->height + tile_height - 1) / tile_height;
+
+    /* the schedule is a per-thread setting, the handler may run outside of main */
+    omp_set_schedule(tiled_schedule, tiled_chunk);
+
+    /* both parts alternate within every tile, their thread time is summed and shares the frame time */
+    const bool profile = sinoscope_profile;
+    double start       = omp_get_wtime();
+    double compute     = 0;
+    double colorize    = 0;
+
+    #pragma omp parallel for collapse(2) schedule(runtime) shared(sinoscope) reduction(+ : compute, colorize)
+    for (unsigned int tile_y = 0; tile_y < tiles_y; tile_y++) {
+        for (unsigned int tile_x = 0; tile_x < tiles_x; tile_x++) {
+            render_tile(sinoscope, tile_x, tile_y, tile_width, tile_height, profile, &compute, &colorize);
         }
     }
 
+    if (profile && compute + colorize > 0) {
+        double elapsed = omp_get_wtime() - start;
+        double series  = start + elapsed * compute / (compute + colorize);
+
+        record_phases(sinoscope, start, series, start + elapsed);
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+/*
+ * Same tiles as the tiled method, one task each, created by a single
+ * thread. Idle threads take the next tile whatever their position, which
+ * balances frames too large for a fixed schedule to split evenly.
+ */
+int sinoscope_image_openmp_tasks(sinoscope_t* sinoscope) {
+    if (sinoscope == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    apply_threads();
+
+    const unsigned int tile_width  = tiled_width;
+    const unsigned int tile_height = tiled_height;
+    const unsigned int tiles_x     = (sinoscope->width + tile_width - 1) / tile_width;
+    const unsigned int tiles_y     = (sinoscope->height + tile_height - 1) / tile_height;
+
+    const bool profile = sinoscope_profile;
+    double start       = omp_get_wtime();
+    double compute     = 0;
+    double colorize    = 0;
+
+    #pragma omp parallel shared(sinoscope, compute, colorize)
+    #pragma omp single
+    #pragma omp taskloop collapse(2) grainsize(1)
+    for (unsigned int tile_y = 0; tile_y < tiles_y; tile_y++) {
+        for (unsigned int tile_x = 0; tile_x < tiles_x; tile_x++) {
+            double tile_compute  = 0;
+            double tile_colorize = 0;
+
+            render_tile(sinoscope, tile_x, tile_y, tile_width, tile_height, profile, &tile_compute, &tile_colorize);
+
+            if (profile) {
+                #pragma omp atomic
+                compute += tile_compute;
+                #pragma omp atomic
+                colorize += tile_colorize;
+            }
+        }
+    }
+
+    if (profile && compute + colorize > 0) {
+        double elapsed = omp_get_wtime() - start;
+        double series  = start + elapsed * compute / (compute + colorize);
+
+        record_phases(sinoscope, start, series, start + elapsed);
+    }
+
     return 0;
 
 fail_exit:
     return -1;
 }
+
+/*
+ * Pages are placed on the NUMA node of the thread that writes them first.
+ * The buffer is cleared in contiguous page blocks, one per thread like the
+ * rows of the static schedule of the openmp handler, so its threads, and
+ * those of a static tiled schedule, write local memory.
+ */
+void sinoscope_openmp_first_touch(unsigned char* buffer, size_t size) {
+    const long pages = (size + FIRST_TOUCH_PAGE - 1) / FIRST_TOUCH_PAGE;
+
+    apply_threads();
+
+    #pragma omp parallel for schedule(static) shared(buffer)
+    for (long p = 0; p < pages; p++) {
+        const size_t offset = p * FIRST_TOUCH_PAGE;
+
+        memset(&buffer[offset], 0, size - offset < FIRST_TOUCH_PAGE ? size - offset : FIRST_TOUCH_PAGE);
+    }
+}
+
+static const char* proc_bind_name(omp_proc_bind_t bind) {
+    switch (bind) {
+    case omp_proc_bind_false:
+        return "false";
+    case omp_proc_bind_true:
+        return "true";
+    case omp_proc_bind_master:
+        return "master";
+    case omp_proc_bind_close:
+        return "close";
+    case omp_proc_bind_spread:
+        return "spread";
+    }
+
+    return "unknown";
+}
+
+void sinoscope_openmp_print_placement(void) {
+    printf("OpenMP placement: bind %s, %d places, %d threads\n", proc_bind_name(omp_get_proc_bind()),
+           omp_get_num_places(), omp_get_max_threads());
+}
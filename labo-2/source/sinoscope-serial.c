@@ -6,39 +6,110 @@
 
 #include "color.h"
 #include "log.h"
+#include "sinoscope-precision.h"
 #include "sinoscope.h"
 
+/* `precision` is a constant in every call, each one is compiled with the arithmetic of its precision */
+static inline __attribute__((always_inline)) void render(sinoscope_t* sinoscope, sinoscope_precision_t precision) {
+    /* row-major so that consecutive pixels land next to each other in the buffer */
+    for (int j = 0; j < sinoscope->height; j++) {
+        for (int i = 0; i < sinoscope->width; i++) {
+            float value = sinoscope_precision_value(sinoscope, i, j, precision);
+
+            pixel_t pixel;
+            color_value(&pixel, value, sinoscope->interval, sinoscope->interval_inverse);
+
+            sinoscope_store_pixel(sinoscope->buffer, i + j * sinoscope->width, &pixel, sinoscope->format);
+        }
+    }
+}
+
 int sinoscope_image_serial(sinoscope_t* sinoscope) {
     if (sinoscope == NULL) {
         LOG_ERROR_NULL_PTR();
         goto fail_exit;
     }
 
+    switch (sinoscope->precision) {
+    case SINOSCOPE_PRECISION_DOUBLE:
+        render(sinoscope, SINOSCOPE_PRECISION_DOUBLE);
+        break;
+    case SINOSCOPE_PRECISION_FLOAT:
+        render(sinoscope, SINOSCOPE_PRECISION_FLOAT);
+        break;
+    case SINOSCOPE_PRECISION_NATIVE:
+        render(sinoscope, SINOSCOPE_PRECISION_NATIVE);
+        break;
+    default:
+        render(sinoscope, SINOSCOPE_PRECISION_DEFAULT);
+        break;
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+/*
+ * The sin term only depends on the row and the cos term only on the column,
+ * so both series are computed once per frame and combined per pixel.
+ */
+int sinoscope_image_serial_separable(sinoscope_t* sinoscope) {
+    if (sinoscope == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    float* columns = malloc((sinoscope->width + sinoscope->height) * sizeof(*columns));
+    if (columns == NULL) {
+        LOG_ERROR_ERRNO("malloc");
+        goto fail_exit;
+    }
+
+    float* rows = columns + sinoscope->width;
+
     for (int i = 0; i < sinoscope->width; i++) {
-        for (int j = 0; j < sinoscope->height; j++) {
-            float px    = sinoscope->dx * j - 2 * M_PI;
-            float py    = sinoscope->dy * i - 2 * M_PI;
-            float value = 0;
+        float py    = sinoscope->dy * i - 2 * M_PI;
+        float value = 0;
+
+        for (int k = 1; k <= sinoscope->taylor; k += 2) {
+            value += cos(py * k * sinoscope->phase0) / k;
+        }
+
+        columns[i] = value;
+    }
+
+    for (int j = 0; j < sinoscope->height; j++) {
+        float px    = sinoscope->dx * j - 2 * M_PI;
+        float value = 0;
 
-            for (int k = 1; k <= sinoscope->taylor; k += 2) {
-                value += sin(px * k * sinoscope->phase1 + sinoscope->time) / k;
-                value += cos(py * k * sinoscope->phase0) / k;
-            }
+        for (int k = 1; k <= sinoscope->taylor; k += 2) {
+            value += sin(px * k * sinoscope->phase1 + sinoscope->time) / k;
+        }
+
+        rows[j] = value;
+    }
+
+    for (int j = 0; j < sinoscope->height; j++) {
+        for (int i = 0; i < sinoscope->width; i++) {
+            float value = rows[j] + columns[i];
 
             value = (atan(value) - atan(-value)) / M_PI;
             value = (value + 1) * 100;
 
-            pixel_t pixel;
-            color_value(&pixel, value, sinoscope->interval, sinoscope->interval_inverse);
+            const pixel_t* pixel = color_lookup(sinoscope->palette, value);
 
             int index = (i * 3) + (j * 3) * sinoscope->width;
 
-            sinoscope->buffer[index + 0] = pixel.bytes[0];
-            sinoscope->buffer[index + 1] = pixel.bytes[1];
-            sinoscope->buffer[index + 2] = pixel.bytes[2];
+            sinoscope->buffer[index + 0] = pixel->bytes[0];
+            sinoscope->buffer[index + 1] = pixel->bytes[1];
+            sinoscope->buffer[index + 2] = pixel->bytes[2];
         }
     }
 
+    free(columns);
+
     return 0;
 
 fail_exit:
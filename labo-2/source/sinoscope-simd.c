@@ -0,0 +1,281 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+#include "approx.h"
+#include "color.h"
+#include "log.h"
+#include "sinoscope.h"
+
+/* maps the accumulated series to [0, 200] like the serial version */
+static inline float simd_scale(float value) {
+    return (2.0f * approx_atanf(value) / (float)M_PI + 1.0f) * 100.0f;
+}
+
+typedef void (*simd_row_handler)(const float* py, float* values, unsigned int count, float row, unsigned int taylor,
+                                 float phase0);
+
+static void simd_row_scalar(const float* py, float* values, unsigned int count, float row, unsigned int taylor,
+                            float phase0) {
+    for (unsigned int i = 0; i < count; i++) {
+        float value = row;
+
+        for (unsigned int k = 1; k <= taylor; k += 2) {
+            value += approx_sincosf(py[i] * k * phase0, 1) / k;
+        }
+
+        values[i] = simd_scale(value);
+    }
+}
+
+#ifdef SIMD_X86
+
+/* lanes past APPROX_REDUCTION_MAX are rare, the whole vector goes through the scalar version */
+__attribute__((target("avx2,fma"))) static __m256 simd_sincos_large_avx2(__m256 x, int quadrant) {
+    float lanes[8] __attribute__((aligned(32)));
+    _mm256_store_ps(lanes, x);
+
+    for (unsigned int i = 0; i < 8; i++) {
+        lanes[i] = approx_sincosf(lanes[i], quadrant);
+    }
+
+    return _mm256_load_ps(lanes);
+}
+
+__attribute__((target("avx2,fma"))) static inline __m256 simd_sincos_avx2(__m256 x, int quadrant) {
+    __m256 large = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x), _mm256_set1_ps(APPROX_REDUCTION_MAX),
+                                 _CMP_GT_OQ);
+    if (!_mm256_testz_ps(large, large)) {
+        return simd_sincos_large_avx2(x, quadrant);
+    }
+
+    __m256 q = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(APPROX_TWO_OVER_PI)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(APPROX_PIO2_1), x);
+    r        = _mm256_fnmadd_ps(q, _mm256_set1_ps(APPROX_PIO2_2), r);
+    r        = _mm256_fnmadd_ps(q, _mm256_set1_ps(APPROX_PIO2_3), r);
+
+    __m256i n = _mm256_add_epi32(_mm256_cvtps_epi32(q), _mm256_set1_epi32(quadrant));
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 sin = _mm256_fmadd_ps(r2, _mm256_set1_ps(APPROX_SIN_3), _mm256_set1_ps(APPROX_SIN_2));
+    sin        = _mm256_fmadd_ps(r2, sin, _mm256_set1_ps(APPROX_SIN_1));
+    sin        = _mm256_fmadd_ps(_mm256_mul_ps(r, r2), sin, r);
+
+    __m256 cos = _mm256_fmadd_ps(r2, _mm256_set1_ps(APPROX_COS_3), _mm256_set1_ps(APPROX_COS_2));
+    cos        = _mm256_fmadd_ps(r2, cos, _mm256_set1_ps(APPROX_COS_1));
+    cos        = _mm256_fmadd_ps(_mm256_mul_ps(r2, r2), cos, _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), r2, _mm256_set1_ps(1.0f)));
+
+    __m256i one      = _mm256_set1_epi32(1);
+    __m256 use_cos   = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(n, one), one));
+    __m256 result    = _mm256_blendv_ps(sin, cos, use_cos);
+    __m256i sign_bit = _mm256_slli_epi32(_mm256_and_si256(n, _mm256_set1_epi32(2)), 30);
+
+    return _mm256_xor_ps(result, _mm256_castsi256_ps(sign_bit));
+}
+
+__attribute__((target("avx2,fma"))) static inline __m256 simd_atan_avx2(__m256 x) {
+    __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    __m256 ax        = _mm256_andnot_ps(sign_mask, x);
+
+    __m256 big = _mm256_cmp_ps(ax, _mm256_set1_ps(APPROX_TAN_3PI_8), _CMP_GT_OQ);
+    __m256 mid = _mm256_andnot_ps(big, _mm256_cmp_ps(ax, _mm256_set1_ps(APPROX_TAN_PI_8), _CMP_GT_OQ));
+
+    __m256 one     = _mm256_set1_ps(1.0f);
+    __m256 x_big   = _mm256_div_ps(_mm256_set1_ps(-1.0f), ax);
+    __m256 x_mid   = _mm256_div_ps(_mm256_sub_ps(ax, one), _mm256_add_ps(ax, one));
+    __m256 reduced = _mm256_blendv_ps(_mm256_blendv_ps(ax, x_mid, mid), x_big, big);
+
+    __m256 y = _mm256_blendv_ps(_mm256_and_ps(mid, _mm256_set1_ps(M_PI_4)), _mm256_set1_ps(M_PI_2), big);
+    __m256 z = _mm256_mul_ps(reduced, reduced);
+
+    __m256 p = _mm256_fmadd_ps(_mm256_set1_ps(APPROX_ATAN_1), z, _mm256_set1_ps(APPROX_ATAN_2));
+    p        = _mm256_fmadd_ps(p, z, _mm256_set1_ps(APPROX_ATAN_3));
+    p        = _mm256_fmadd_ps(p, z, _mm256_set1_ps(APPROX_ATAN_4));
+    p        = _mm256_fmadd_ps(_mm256_mul_ps(p, z), reduced, reduced);
+    y        = _mm256_add_ps(y, p);
+
+    return _mm256_or_ps(y, _mm256_and_ps(sign_mask, x));
+}
+
+__attribute__((target("avx2,fma"))) static void simd_row_avx2(const float* py, float* values, unsigned int count,
+                                                              float row, unsigned int taylor, float phase0) {
+    const unsigned int width = 8;
+
+    for (unsigned int i = 0; i < count; i += width) {
+        __m256 p     = _mm256_load_ps(&py[i]);
+        __m256 value = _mm256_set1_ps(row);
+
+        for (unsigned int k = 1; k <= taylor; k += 2) {
+            __m256 arg = _mm256_mul_ps(_mm256_mul_ps(p, _mm256_set1_ps(k)), _mm256_set1_ps(phase0));
+            value      = _mm256_add_ps(value, _mm256_div_ps(simd_sincos_avx2(arg, 1), _mm256_set1_ps(k)));
+        }
+
+        __m256 scaled = _mm256_mul_ps(simd_atan_avx2(value), _mm256_set1_ps(2.0f / M_PI));
+        scaled        = _mm256_mul_ps(_mm256_add_ps(scaled, _mm256_set1_ps(1.0f)), _mm256_set1_ps(100.0f));
+
+        _mm256_store_ps(&values[i], scaled);
+    }
+}
+
+__attribute__((target("avx512f"))) static __m512 simd_sincos_large_avx512(__m512 x, int quadrant) {
+    float lanes[16] __attribute__((aligned(64)));
+    _mm512_store_ps(lanes, x);
+
+    for (unsigned int i = 0; i < 16; i++) {
+        lanes[i] = approx_sincosf(lanes[i], quadrant);
+    }
+
+    return _mm512_load_ps(lanes);
+}
+
+__attribute__((target("avx512f"))) static inline __m512 simd_sincos_avx512(__m512 x, int quadrant) {
+    if (_mm512_cmp_ps_mask(_mm512_abs_ps(x), _mm512_set1_ps(APPROX_REDUCTION_MAX), _CMP_GT_OQ) != 0) {
+        return simd_sincos_large_avx512(x, quadrant);
+    }
+
+    __m512 q = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(APPROX_TWO_OVER_PI)),
+                                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_fnmadd_ps(q, _mm512_set1_ps(APPROX_PIO2_1), x);
+    r        = _mm512_fnmadd_ps(q, _mm512_set1_ps(APPROX_PIO2_2), r);
+    r        = _mm512_fnmadd_ps(q, _mm512_set1_ps(APPROX_PIO2_3), r);
+
+    __m512i n = _mm512_add_epi32(_mm512_cvtps_epi32(q), _mm512_set1_epi32(quadrant));
+    __m512 r2 = _mm512_mul_ps(r, r);
+
+    __m512 sin = _mm512_fmadd_ps(r2, _mm512_set1_ps(APPROX_SIN_3), _mm512_set1_ps(APPROX_SIN_2));
+    sin        = _mm512_fmadd_ps(r2, sin, _mm512_set1_ps(APPROX_SIN_1));
+    sin        = _mm512_fmadd_ps(_mm512_mul_ps(r, r2), sin, r);
+
+    __m512 cos = _mm512_fmadd_ps(r2, _mm512_set1_ps(APPROX_COS_3), _mm512_set1_ps(APPROX_COS_2));
+    cos        = _mm512_fmadd_ps(r2, cos, _mm512_set1_ps(APPROX_COS_1));
+    cos        = _mm512_fmadd_ps(_mm512_mul_ps(r2, r2), cos, _mm512_fnmadd_ps(_mm512_set1_ps(0.5f), r2, _mm512_set1_ps(1.0f)));
+
+    __mmask16 use_cos = _mm512_test_epi32_mask(n, _mm512_set1_epi32(1));
+    __m512 result     = _mm512_mask_blend_ps(use_cos, sin, cos);
+    __m512i sign_bit  = _mm512_slli_epi32(_mm512_and_si512(n, _mm512_set1_epi32(2)), 30);
+
+    return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(result), sign_bit));
+}
+
+__attribute__((target("avx512f"))) static inline __m512 simd_atan_avx512(__m512 x) {
+    __m512i sign_mask = _mm512_set1_epi32(0x80000000);
+    __m512 ax         = _mm512_abs_ps(x);
+
+    __mmask16 big = _mm512_cmp_ps_mask(ax, _mm512_set1_ps(APPROX_TAN_3PI_8), _CMP_GT_OQ);
+    __mmask16 mid = _mm512_cmp_ps_mask(ax, _mm512_set1_ps(APPROX_TAN_PI_8), _CMP_GT_OQ) & ~big;
+
+    __m512 one     = _mm512_set1_ps(1.0f);
+    __m512 reduced = _mm512_mask_div_ps(ax, mid, _mm512_sub_ps(ax, one), _mm512_add_ps(ax, one));
+    reduced        = _mm512_mask_div_ps(reduced, big, _mm512_set1_ps(-1.0f), ax);
+
+    __m512 y = _mm512_maskz_mov_ps(mid, _mm512_set1_ps(M_PI_4));
+    y        = _mm512_mask_mov_ps(y, big, _mm512_set1_ps(M_PI_2));
+    __m512 z = _mm512_mul_ps(reduced, reduced);
+
+    __m512 p = _mm512_fmadd_ps(_mm512_set1_ps(APPROX_ATAN_1), z, _mm512_set1_ps(APPROX_ATAN_2));
+    p        = _mm512_fmadd_ps(p, z, _mm512_set1_ps(APPROX_ATAN_3));
+    p        = _mm512_fmadd_ps(p, z, _mm512_set1_ps(APPROX_ATAN_4));
+    p        = _mm512_fmadd_ps(_mm512_mul_ps(p, z), reduced, reduced);
+    y        = _mm512_add_ps(y, p);
+
+    __m512i sign = _mm512_and_si512(_mm512_castps_si512(x), sign_mask);
+    return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(y), sign));
+}
+
+__attribute__((target("avx512f"))) static void simd_row_avx512(const float* py, float* values, unsigned int count,
+                                                               float row, unsigned int taylor, float phase0) {
+    const unsigned int width = 16;
+
+    for (unsigned int i = 0; i < count; i += width) {
+        __m512 p     = _mm512_load_ps(&py[i]);
+        __m512 value = _mm512_set1_ps(row);
+
+        for (unsigned int k = 1; k <= taylor; k += 2) {
+            __m512 arg = _mm512_mul_ps(_mm512_mul_ps(p, _mm512_set1_ps(k)), _mm512_set1_ps(phase0));
+            value      = _mm512_add_ps(value, _mm512_div_ps(simd_sincos_avx512(arg, 1), _mm512_set1_ps(k)));
+        }
+
+        __m512 scaled = _mm512_mul_ps(simd_atan_avx512(value), _mm512_set1_ps(2.0f / M_PI));
+        scaled        = _mm512_mul_ps(_mm512_add_ps(scaled, _mm512_set1_ps(1.0f)), _mm512_set1_ps(100.0f));
+
+        _mm512_store_ps(&values[i], scaled);
+    }
+}
+
+#endif /* SIMD_X86 */
+
+static simd_row_handler simd_get_row_handler(void) {
+#ifdef SIMD_X86
+    if (__builtin_cpu_supports("avx512f")) {
+        return simd_row_avx512;
+    }
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return simd_row_avx2;
+    }
+#endif
+
+    return simd_row_scalar;
+}
+
+int sinoscope_image_simd(sinoscope_t* sinoscope) {
+    if (sinoscope == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    /* rows are padded to a whole number of AVX-512 vectors, extra lanes are ignored */
+    const unsigned int lanes  = 16;
+    const unsigned int padded = (sinoscope->width + lanes - 1) / lanes * lanes;
+
+    /* the coordinates only depend on the size, they are kept for every frame */
+    if (sinoscope->simd_columns == NULL) {
+        sinoscope->simd_columns = aligned_alloc(64, 2 * padded * sizeof(float));
+        if (sinoscope->simd_columns == NULL) {
+            LOG_ERROR_ERRNO("aligned_alloc");
+            goto fail_exit;
+        }
+
+        for (unsigned int i = 0; i < padded; i++) {
+            sinoscope->simd_columns[i] = sinoscope->dy * i - 2 * M_PI;
+        }
+    }
+
+    float* py     = sinoscope->simd_columns;
+    float* values = py + padded;
+
+    simd_row_handler row_handler = simd_get_row_handler();
+
+    for (unsigned int j = 0; j < sinoscope->height; j++) {
+        /* the sin term only depends on the row, it is shared by every lane */
+        float px  = sinoscope->dx * j - 2 * M_PI;
+        float row = 0;
+
+        for (unsigned int k = 1; k <= sinoscope->taylor; k += 2) {
+            row += approx_sincosf(px * k * sinoscope->phase1 + sinoscope->time, 0) / k;
+        }
+
+        row_handler(py, values, padded, row, sinoscope->taylor, sinoscope->phase0);
+
+        unsigned char* line = &sinoscope->buffer[j * sinoscope->width * 3];
+
+        for (unsigned int i = 0; i < sinoscope->width; i++) {
+            const pixel_t* pixel = color_lookup(sinoscope->palette, values[i]);
+
+            line[i * 3 + 0] = pixel->bytes[0];
+            line[i * 3 + 1] = pixel->bytes[1];
+            line[i * 3 + 2] = pixel->bytes[2];
+        }
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
@@ -0,0 +1,553 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+#include "sinoscope.h"
+
+typedef struct sweep_result {
+    const sinoscope_method_t* method;
+    unsigned int threads;
+    const char* schedule;
+    size_t local_size[2];
+    double median_us;
+} sweep_result_t;
+
+void sinoscope_sweep_defaults(sinoscope_sweep_t* sweep) {
+    memset(sweep, 0, sizeof(*sweep));
+
+    sinoscope_sweep_option(sweep, "sizes", "256x256,512x512,1024x1024");
+    sinoscope_sweep_option(sweep, "taylor", "3,6,12");
+    sinoscope_sweep_option(sweep, "threads", "1,0");
+    sinoscope_sweep_option(sweep, "schedules", "static,dynamic,guided");
+    sinoscope_sweep_option(sweep, "local", "auto,8x1,16x4,32x8");
+
+    sweep->warmup = 2;
+    sweep->trials = 7;
+}
+
+/* `WxH`, `W` alone is a square; `auto` is zero when `allow_auto` is set */
+static int parse_size(const char* item, size_t* size, bool allow_auto) {
+    if (allow_auto && strcmp(item, "auto") == 0) {
+        size[0] = 0;
+        size[1] = 0;
+        return 0;
+    }
+
+    char* end;
+    long width = strtol(item, &end, 10);
+    if (end == item || width <= 0) {
+        return -1;
+    }
+
+    long height = width;
+    if (*end == 'x') {
+        const char* next = end + 1;
+        height           = strtol(next, &end, 10);
+        if (end == next || height <= 0) {
+            return -1;
+        }
+    }
+
+    if (*end != '\0') {
+        return -1;
+    }
+
+    size[0] = width;
+    size[1] = height;
+    return 0;
+}
+
+static int parse_count(const char* item, unsigned int* value, bool allow_zero) {
+    char* end;
+    long parsed = strtol(item, &end, 10);
+
+    if (end == item || *end != '\0' || parsed < 0 || (parsed == 0 && !allow_zero)) {
+        return -1;
+    }
+
+    *value = parsed;
+    return 0;
+}
+
+static int parse_item(sinoscope_sweep_t* sweep, const char* key, const char* item, unsigned int index) {
+    size_t size[2];
+
+    if (strcmp(key, "sizes") == 0) {
+        if (parse_size(item, size, false) < 0) {
+            return -1;
+        }
+        sweep->sizes[index][0] = size[0];
+        sweep->sizes[index][1] = size[1];
+        sweep->size_count      = index + 1;
+    } else if (strcmp(key, "taylor") == 0) {
+        if (parse_count(item, &sweep->taylors[index], false) < 0) {
+            return -1;
+        }
+        sweep->taylor_count = index + 1;
+    } else if (strcmp(key, "threads") == 0) {
+        if (parse_count(item, &sweep->threads[index], true) < 0) {
+            return -1;
+        }
+        sweep->thread_count = index + 1;
+    } else if (strcmp(key, "schedules") == 0) {
+        if (strcmp(item, "static") != 0 && strcmp(item, "dynamic") != 0 && strcmp(item, "guided") != 0) {
+            return -1;
+        }
+        snprintf(sweep->schedules[index], sizeof(sweep->schedules[index]), "%s", item);
+        sweep->schedule_count = index + 1;
+    } else if (strcmp(key, "local") == 0) {
+        if (parse_size(item, sweep->local_sizes[index], true) < 0) {
+            return -1;
+        }
+        sweep->local_size_count = index + 1;
+    } else if (strcmp(key, "methods") == 0) {
+        sweep->methods[index] = sinoscope_find_method(item);
+        if (sweep->methods[index] == NULL) {
+            return -1;
+        }
+        sweep->method_count = index + 1;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+int sinoscope_sweep_option(sinoscope_sweep_t* sweep, const char* key, const char* value) {
+    if (strcmp(key, "format") == 0) {
+        if (strcmp(value, "csv") != 0 && strcmp(value, "json") != 0) {
+            goto fail_exit;
+        }
+        sweep->json = strcmp(value, "json") == 0;
+        return 0;
+    }
+
+    if (strcmp(key, "best") == 0) {
+        sweep->best_path = (char*)value;
+        return 0;
+    }
+
+    if (strcmp(key, "warmup") == 0) {
+        return parse_count(value, &sweep->warmup, true);
+    }
+
+    if (strcmp(key, "trials") == 0) {
+        return parse_count(value, &sweep->trials, false);
+    }
+
+    char list[256];
+    if (snprintf(list, sizeof(list), "%s", value) >= (int)sizeof(list)) {
+        goto fail_exit;
+    }
+
+    unsigned int index = 0;
+    char* cursor       = list;
+    char* item;
+
+    while ((item = strsep(&cursor, ",")) != NULL) {
+        if (index >= SINOSCOPE_SWEEP_MAX) {
+            LOG_ERROR("at most %d values per sweep option", SINOSCOPE_SWEEP_MAX);
+            goto fail_exit;
+        }
+
+        if (parse_item(sweep, key, item, index++) < 0) {
+            goto fail_exit;
+        }
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+/* median time of the handler alone, the frames in between are not timed */
+static int run_trials(sinoscope_t* sinoscope, const sinoscope_sweep_t* sweep, double* median_us) {
+    double times[sweep->trials];
+
+    for (unsigned int i = 0; i < sweep->warmup + sweep->trials; i++) {
+        if (sinoscope_corners(sinoscope) < 0) {
+            LOG_ERROR("failed to forward sinoscope");
+            goto fail_exit;
+        }
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        if (sinoscope->handler(sinoscope) < 0) {
+            LOG_ERROR("failed to call sinoscope handler `%s`", sinoscope->name);
+            goto fail_exit;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if (i >= sweep->warmup) {
+            times[i - sweep->warmup] = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+        }
+    }
+
+    if (sinoscope_opencl_drain(sinoscope) < 0) {
+        LOG_ERROR("failed to drain sinoscope `%s`", sinoscope->name);
+        goto fail_exit;
+    }
+
+    qsort(times, sweep->trials, sizeof(times[0]), compare_doubles);
+
+    unsigned int middle = sweep->trials / 2;
+    *median_us          = (sweep->trials % 2) ? times[middle] : (times[middle - 1] + times[middle]) / 2;
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+static void write_header(FILE* output, const sinoscope_sweep_t* sweep) {
+    if (sweep->json) {
+        fprintf(output, "[");
+    } else {
+        fprintf(output, "width,height,taylor,method,threads,schedule,local,median_us,fps,speedup\n");
+    }
+}
+
+static void write_footer(FILE* output, const sinoscope_sweep_t* sweep) {
+    if (sweep->json) {
+        fprintf(output, "\n]\n");
+    }
+}
+
+/* parameters a method does not use are left empty in CSV and null in JSON */
+static void write_result(FILE* output, const sinoscope_sweep_t* sweep, bool first, unsigned int width,
+                         unsigned int height, unsigned int taylor, const sweep_result_t* result, double baseline_us) {
+    const sinoscope_method_t* method = result->method;
+    double fps                       = 1e6 / result->median_us;
+    double speedup                   = baseline_us / result->median_us;
+
+    char threads[16] = "";
+    char local[32]   = "";
+
+    if (method->tunables & SINOSCOPE_TUNE_THREADS) {
+        snprintf(threads, sizeof(threads), "%u", result->threads);
+    }
+
+    if (method->tunables & SINOSCOPE_TUNE_LOCAL) {
+        if (result->local_size[0] == 0) {
+            snprintf(local, sizeof(local), "runtime");
+        } else {
+            snprintf(local, sizeof(local), "%zux%zu", result->local_size[0], result->local_size[1]);
+        }
+    }
+
+    const char* schedule = (method->tunables & SINOSCOPE_TUNE_SCHEDULE) ? result->schedule : "";
+
+    if (!sweep->json) {
+        fprintf(output, "%u,%u,%u,%s,%s,%s,%s,%.1f,%.2f,%.3f\n", width, height, taylor, method->name, threads, schedule,
+                local, result->median_us, fps, speedup);
+        return;
+    }
+
+    fprintf(output, "%s\n  {\"width\": %u, \"height\": %u, \"taylor\": %u, \"method\": \"%s\", ", first ? "" : ",",
+            width, height, taylor, method->name);
+
+    if (threads[0] != '\0') {
+        fprintf(output, "\"threads\": %s, ", threads);
+    } else {
+        fprintf(output, "\"threads\": null, ");
+    }
+
+    if (schedule[0] != '\0') {
+        fprintf(output, "\"schedule\": \"%s\", ", schedule);
+    } else {
+        fprintf(output, "\"schedule\": null, ");
+    }
+
+    if (local[0] != '\0') {
+        fprintf(output, "\"local\": \"%s\", ", local);
+    } else {
+        fprintf(output, "\"local\": null, ");
+    }
+
+    fprintf(output, "\"median_us\": %.1f, \"fps\": %.2f, \"speedup\": %.3f}", result->median_us, fps, speedup);
+}
+
+static void write_best(FILE* best, unsigned int width, unsigned int height, unsigned int taylor,
+                       const sweep_result_t* result) {
+    const sinoscope_method_t* method = result->method;
+
+    fprintf(best, "%u,%u,%u,%s,", width, height, taylor, method->name);
+
+    if (method->tunables & SINOSCOPE_TUNE_THREADS) {
+        fprintf(best, "%u", result->threads);
+    }
+    fprintf(best, ",%s,", (method->tunables & SINOSCOPE_TUNE_SCHEDULE) ? result->schedule : "");
+
+    if ((method->tunables & SINOSCOPE_TUNE_LOCAL) && result->local_size[0] != 0) {
+        fprintf(best, "%zux%zu", result->local_size[0], result->local_size[1]);
+    }
+    fprintf(best, ",%.1f\n", result->median_us);
+}
+
+static bool sweep_selects(const sinoscope_sweep_t* sweep, const sinoscope_method_t* method) {
+    if (sweep->method_count == 0) {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < sweep->method_count; i++) {
+        if (sweep->methods[i] == method) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int run_method(sinoscope_t* sinoscope, const sinoscope_sweep_t* sweep, sweep_result_t* result) {
+    const sinoscope_method_t* method = result->method;
+
+    if (method->tunables & SINOSCOPE_TUNE_THREADS) {
+        sinoscope_openmp_set_threads(result->threads);
+        result->threads = sinoscope_openmp_max_threads();
+    }
+
+    if ((method->tunables & SINOSCOPE_TUNE_SCHEDULE) && sinoscope_openmp_configure(result->schedule, 0, 0, 0) < 0) {
+        return -1;
+    }
+
+    if (method->tunables & SINOSCOPE_TUNE_LOCAL) {
+        if (sinoscope_opencl_set_local_size(sinoscope->opencl, result->local_size) < 0) {
+            return -1;
+        }
+    }
+
+    return run_trials(sinoscope, sweep, &result->median_us);
+}
+
+int sinoscope_sweep(const sinoscope_sweep_t* sweep, const char* path, const cl_device_id* device_id,
+                    sinoscope_opencl_memory_t memory, float max) {
+    FILE* best                 = NULL;
+    sinoscope_opencl_t* opencl = NULL;
+    sinoscope_opencl_t opencl_storage;
+
+    FILE* output = fopen(path, "w");
+    if (output == NULL) {
+        LOG_ERROR_ERRNO("fopen");
+        goto fail_exit;
+    }
+
+    if (sweep->best_path != NULL) {
+        best = fopen(sweep->best_path, "w");
+        if (best == NULL) {
+            LOG_ERROR_ERRNO("fopen");
+            goto fail_close_output;
+        }
+        fprintf(best, "width,height,taylor,method,threads,schedule,local,median_us\n");
+    }
+
+    write_header(output, sweep);
+    bool first = true;
+
+    for (unsigned int s = 0; s < sweep->size_count; s++) {
+        unsigned int width  = sweep->sizes[s][0];
+        unsigned int height = sweep->sizes[s][1];
+
+        size_t tuned_local[2] = {0, 0};
+
+        if (device_id != NULL) {
+            opencl_storage.memory        = memory;
+            opencl_storage.local_size[0] = 0;
+            opencl_storage.local_size[1] = 0;
+            opencl_storage.precision     = sinoscope_precision;
+
+            if (sinoscope_opencl_init(&opencl_storage, *device_id, width, height) < 0) {
+                LOG_ERROR("failed to initialize OpenCL context");
+                goto fail_close_best;
+            }
+
+            opencl         = &opencl_storage;
+            tuned_local[0] = opencl->local_size[0];
+            tuned_local[1] = opencl->local_size[1];
+        }
+
+        for (unsigned int t = 0; t < sweep->taylor_count; t++) {
+            unsigned int taylor    = sweep->taylors[t];
+            double baseline_us     = 0;
+            sweep_result_t fastest = {NULL};
+
+            for (unsigned int m = 0; m < sinoscope_method_count; m++) {
+                const sinoscope_method_t* method = &sinoscope_methods[m];
+
+                /* serial always runs first, it is the speedup baseline */
+                if (m > 0 && (!sweep_selects(sweep, method) || (method->opencl && opencl == NULL) ||
+                              !sinoscope_method_renders(method, sinoscope_precision))) {
+                    continue;
+                }
+
+                bool threaded  = method->tunables & SINOSCOPE_TUNE_THREADS;
+                bool scheduled = method->tunables & SINOSCOPE_TUNE_SCHEDULE;
+                bool local     = method->tunables & SINOSCOPE_TUNE_LOCAL;
+
+                unsigned int thread_count   = threaded ? sweep->thread_count : 1;
+                unsigned int schedule_count = scheduled ? sweep->schedule_count : 1;
+                unsigned int local_count    = local ? sweep->local_size_count : 1;
+
+                sinoscope_t* sinoscope = sinoscope_create(method->name, method->handler, width, height, max,
+                                                                  SINOSCOPE_FORMAT_RGB8);
+                if (sinoscope == NULL) {
+                    LOG_ERROR("failed to create sinoscope (%s)", method->name);
+                    goto fail_cleanup_opencl;
+                }
+                sinoscope->taylor = taylor;
+                sinoscope->opencl = opencl;
+
+                for (unsigned int i = 0; i < thread_count; i++) {
+                    for (unsigned int j = 0; j < schedule_count; j++) {
+                        for (unsigned int k = 0; k < local_count; k++) {
+                            sweep_result_t result = {0};
+                            result.method         = method;
+                            result.threads        = threaded ? sweep->threads[i] : 0;
+                            result.schedule       = scheduled ? sweep->schedules[j] : "";
+
+                            /* `auto` is the size picked by sinoscope_opencl_init */
+                            if (local) {
+                                bool tuned           = sweep->local_sizes[k][0] == 0;
+                                result.local_size[0] = tuned ? tuned_local[0] : sweep->local_sizes[k][0];
+                                result.local_size[1] = tuned ? tuned_local[1] : sweep->local_sizes[k][1];
+                            }
+
+                            /* an unsupported local size or a failing backend only loses its row */
+                            if (run_method(sinoscope, sweep, &result) < 0) {
+                                LOG_ERROR("skipping %s at %ux%u", method->name, width, height);
+                                continue;
+                            }
+
+                            if (m == 0) {
+                                baseline_us = result.median_us;
+                            }
+
+                            write_result(output, sweep, first, width, height, taylor, &result, baseline_us);
+                            first = false;
+
+                            if (fastest.method == NULL || result.median_us < fastest.median_us) {
+                                fastest = result;
+                            }
+                        }
+                    }
+                }
+
+                sinoscope_destroy(sinoscope);
+            }
+
+            if (fastest.method == NULL) {
+                LOG_ERROR("no method ran at %ux%u", width, height);
+                goto fail_cleanup_opencl;
+            }
+
+            printf("%ux%u taylor %u: %s %.1f us\n", width, height, taylor, fastest.method->name, fastest.median_us);
+
+            if (best != NULL) {
+                write_best(best, width, height, taylor, &fastest);
+            }
+        }
+
+        if (opencl != NULL) {
+            sinoscope_opencl_cleanup(opencl);
+            opencl = NULL;
+        }
+    }
+
+    write_footer(output, sweep);
+
+    /* later runs of this process use the defaults again */
+    sinoscope_openmp_set_threads(0);
+
+    if (best != NULL) {
+        fclose(best);
+    }
+    fclose(output);
+
+    return 0;
+
+fail_cleanup_opencl:
+    if (opencl != NULL) {
+        sinoscope_opencl_cleanup(opencl);
+    }
+fail_close_best:
+    if (best != NULL) {
+        fclose(best);
+    }
+fail_close_output:
+    fclose(output);
+fail_exit:
+    return -1;
+}
+
+int sinoscope_sweep_load(const char* path, unsigned int width, unsigned int height, unsigned int taylor,
+                         sinoscope_tuning_t* tuning) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        LOG_ERROR_ERRNO("fopen");
+        return -1;
+    }
+
+    int found = 0;
+    char line[256];
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+
+        char* cursor = line;
+        char* fields[8];
+        unsigned int count = 0;
+
+        while (count < 8 && (fields[count] = strsep(&cursor, ",")) != NULL) {
+            count++;
+        }
+
+        /* the header and malformed lines do not parse as a size */
+        unsigned int entry_width, entry_height, entry_taylor;
+        if (count < 7 || parse_count(fields[0], &entry_width, false) < 0 ||
+            parse_count(fields[1], &entry_height, false) < 0 || parse_count(fields[2], &entry_taylor, false) < 0) {
+            continue;
+        }
+
+        if (entry_width != width || entry_height != height) {
+            continue;
+        }
+
+        /* another taylor degree is only used when there is no exact entry */
+        if (found && entry_taylor != taylor) {
+            continue;
+        }
+
+        memset(tuning, 0, sizeof(*tuning));
+        snprintf(tuning->method, sizeof(tuning->method), "%s", fields[3]);
+        snprintf(tuning->schedule, sizeof(tuning->schedule), "%s", fields[5]);
+
+        if (fields[4][0] != '\0') {
+            parse_count(fields[4], &tuning->threads, true);
+        }
+
+        if (fields[6][0] != '\0' && parse_size(fields[6], tuning->local_size, false) < 0) {
+            tuning->local_size[0] = 0;
+            tuning->local_size[1] = 0;
+        }
+
+        found = 1;
+
+        if (entry_taylor == taylor) {
+            break;
+        }
+    }
+
+    fclose(file);
+
+    return found;
+}
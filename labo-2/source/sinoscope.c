@@ -2,6 +2,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/resource.h>
 #include <time.h>
 
@@ -16,10 +17,174 @@ typedef struct timespec timespec_t;
 typedef struct timeval timeval_t;
 typedef struct rusage rusage_t;
 
-static const unsigned int BYTE_PER_PIXEL = 3;
+
+/* OpenCL runtimes only wrap page aligned host memory without copying it */
+static const size_t BUFFER_ALIGNMENT = 4096;
+
+/* the first levels of the adaptive mode divide the resolution, the next ones the taylor degree */
+static const unsigned int ADAPTIVE_SCALE_LEVELS = 2;
+/* frames over the budget before lowering the quality, and with room to spare before raising it */
+static const unsigned int ADAPTIVE_SLOW_FRAMES = 3;
+static const unsigned int ADAPTIVE_FAST_FRAMES = 30;
+/* part of the budget the next level may be expected to use */
+static const float ADAPTIVE_HEADROOM = 0.8f;
+
+/* the float kernels and the separable sums round differently than serial */
+const sinoscope_method_t sinoscope_methods[] = {
+    {.name = "serial", .variant = "serial", .handler = sinoscope_image_serial, .rgba8 = true, .precisions = true},
+    {.name = "openmp", .variant = "mp", .handler = sinoscope_image_openmp,
+     .tunables = SINOSCOPE_TUNE_THREADS, .rgba8 = true, .precisions = true},
+    {.name = "opencl", .variant = "cl", .handler = sinoscope_image_opencl,
+     .opencl = true, .max_diff = 10, .rgba8 = true, .precisions = true},
+    {.name = "simd", .variant = "simd", .handler = sinoscope_image_simd, .max_diff = 10},
+    {.name = "serial-separable", .variant = "sep", .handler = sinoscope_image_serial_separable, .max_diff = 10},
+    {.name = "openmp-separable", .variant = "mp-sep", .handler = sinoscope_image_openmp_separable,
+     .max_diff = 10, .tunables = SINOSCOPE_TUNE_THREADS, .rgba8 = true},
+    {.name = "opencl-separable", .variant = "cl-sep", .handler = sinoscope_image_opencl_separable,
+     .opencl = true, .max_diff = 10, .precisions = true},
+    {.name = "openmp-tiled", .variant = "mp-tiled", .handler = sinoscope_image_openmp_tiled,
+     .tunables = SINOSCOPE_TUNE_THREADS | SINOSCOPE_TUNE_SCHEDULE},
+    {.name = "opencl-async", .variant = "cl-async", .handler = sinoscope_image_opencl_async,
+     .opencl = true, .max_diff = 10, .precisions = true},
+    {.name = "opencl-2d", .variant = "cl-2d", .handler = sinoscope_image_opencl_2d,
+     .opencl = true, .max_diff = 10, .tunables = SINOSCOPE_TUNE_LOCAL, .rgba8 = true, .precisions = true},
+    {.name = "openmp-cached", .variant = "mp-cached", .handler = sinoscope_image_openmp_cached,
+     .max_diff = 10, .tunables = SINOSCOPE_TUNE_THREADS},
+    {.name = "opencl-hybrid", .variant = "cl-hybrid", .handler = sinoscope_image_opencl_hybrid,
+     .opencl = true, .max_diff = 10, .tunables = SINOSCOPE_TUNE_THREADS, .rgba8 = true},
+    {.name = "openmp-tasks", .variant = "mp-tasks", .handler = sinoscope_image_openmp_tasks,
+     .tunables = SINOSCOPE_TUNE_THREADS},
+};
+
+float sinoscope_reuse_tolerance           = 0;
+bool sinoscope_profile                    = false;
+sinoscope_precision_t sinoscope_precision = SINOSCOPE_PRECISION_DEFAULT;
+
+const unsigned int sinoscope_method_count = sizeof(sinoscope_methods) / sizeof(sinoscope_methods[0]);
+
+const sinoscope_method_t* sinoscope_find_method(const char* name) {
+    for (unsigned int i = 0; i < sinoscope_method_count; i++) {
+        if (strcmp(sinoscope_methods[i].name, name) == 0 || strcmp(sinoscope_methods[i].variant, name) == 0) {
+            return &sinoscope_methods[i];
+        }
+    }
+
+    return NULL;
+}
+
+int sinoscope_parse_format(const char* name, sinoscope_format_t* format) {
+    if (strcmp(name, "rgb8") == 0) {
+        *format = SINOSCOPE_FORMAT_RGB8;
+    } else if (strcmp(name, "rgba8") == 0) {
+        *format = SINOSCOPE_FORMAT_RGBA8;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+const char* sinoscope_format_name(sinoscope_format_t format) {
+    switch (format) {
+    case SINOSCOPE_FORMAT_RGB8:
+        return "rgb8";
+    case SINOSCOPE_FORMAT_RGBA8:
+        return "rgba8";
+    }
+
+    return "unknown";
+}
+
+const char* sinoscope_phase_name(sinoscope_phase_t phase) {
+    switch (phase) {
+    case SINOSCOPE_PHASE_KERNEL:
+        return "kernel";
+    case SINOSCOPE_PHASE_READBACK:
+        return "readback";
+    case SINOSCOPE_PHASE_ENQUEUE:
+        return "enqueue";
+    case SINOSCOPE_PHASE_COMPUTE:
+        return "compute";
+    case SINOSCOPE_PHASE_COLORIZE:
+        return "colorize";
+    case SINOSCOPE_PHASE_COUNT:
+        break;
+    }
+
+    return "unknown";
+}
+
+int sinoscope_parse_precision(const char* name, sinoscope_precision_t* precision) {
+    for (unsigned int i = 0; i < SINOSCOPE_PRECISION_COUNT; i++) {
+        if (strcmp(sinoscope_precision_name(i), name) == 0) {
+            *precision = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char* sinoscope_precision_name(sinoscope_precision_t precision) {
+    switch (precision) {
+    case SINOSCOPE_PRECISION_DEFAULT:
+        return "default";
+    case SINOSCOPE_PRECISION_DOUBLE:
+        return "double";
+    case SINOSCOPE_PRECISION_FLOAT:
+        return "float";
+    case SINOSCOPE_PRECISION_NATIVE:
+        return "native";
+    case SINOSCOPE_PRECISION_COUNT:
+        break;
+    }
+
+    return "unknown";
+}
+
+bool sinoscope_method_supports(const sinoscope_method_t* method, sinoscope_format_t format) {
+    return format == SINOSCOPE_FORMAT_RGB8 || method->rgba8;
+}
+
+bool sinoscope_method_renders(const sinoscope_method_t* method, sinoscope_precision_t precision) {
+    return precision == SINOSCOPE_PRECISION_DEFAULT || method->precisions;
+}
+
+int sinoscope_select_method(sinoscope_t* sinoscope, const char* name) {
+    const sinoscope_method_t* method = sinoscope_find_method(name);
+
+    /* the buffer keeps its format and the frames their precision, whatever the method */
+    if (method == NULL || (method->opencl && sinoscope->opencl == NULL) ||
+        !sinoscope_method_supports(method, sinoscope->format) ||
+        !sinoscope_method_renders(method, sinoscope->precision)) {
+        return -1;
+    }
+
+    sinoscope->name    = method->name;
+    sinoscope->handler = method->handler;
+
+    return 0;
+}
+
+size_t sinoscope_buffer_allocation(size_t size) {
+    return (size + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+}
+
+unsigned char* sinoscope_alloc_buffer(size_t size) {
+    unsigned char* buffer = aligned_alloc(BUFFER_ALIGNMENT, sinoscope_buffer_allocation(size));
+    if (buffer == NULL) {
+        LOG_ERROR_ERRNO("aligned_alloc");
+        return NULL;
+    }
+
+    /* before any handler writes it, so that the pages follow the openmp schedule */
+    sinoscope_openmp_first_touch(buffer, sinoscope_buffer_allocation(size));
+
+    return buffer;
+}
 
 sinoscope_t* sinoscope_create(char* name, sinoscope_handler handler, unsigned int width, unsigned int height,
-                              float max) {
+                              float max, sinoscope_format_t format) {
     sinoscope_t* sinoscope = malloc(sizeof(*sinoscope));
     if (sinoscope == NULL) {
         LOG_ERROR_ERRNO("malloc");
@@ -29,10 +194,13 @@ sinoscope_t* sinoscope_create(char* name, sinoscope_handler handler, unsigned in
     sinoscope->name    = name;
     sinoscope->handler = handler;
 
-    sinoscope->buffer_size = width * height * BYTE_PER_PIXEL;
-    sinoscope->buffer      = malloc(sinoscope->buffer_size);
+    sinoscope->format      = format;
+    sinoscope->pixel_size  = (format == SINOSCOPE_FORMAT_RGBA8) ? 4 : 3;
+    sinoscope->precision   = sinoscope_precision;
+    sinoscope->buffer_size = width * height * sinoscope->pixel_size;
+    sinoscope->buffer      = sinoscope_alloc_buffer(sinoscope->buffer_size);
     if (sinoscope->buffer == NULL) {
-        LOG_ERROR_ERRNO("malloc");
+        LOG_ERROR("failed to allocate the sinoscope buffer");
         goto fail_free_sinoscope;
     }
 
@@ -42,6 +210,7 @@ sinoscope_t* sinoscope_create(char* name, sinoscope_handler handler, unsigned in
 
     sinoscope->interval         = color_get_interval(max);
     sinoscope->interval_inverse = color_get_interval_inverse(max);
+    color_palette(sinoscope->palette, sinoscope->interval, sinoscope->interval_inverse);
 
     sinoscope->time   = 0;
     sinoscope->max    = max;
@@ -51,6 +220,14 @@ sinoscope_t* sinoscope_create(char* name, sinoscope_handler handler, unsigned in
     sinoscope->dy     = 3 * M_PI / height;
     sinoscope->opencl = NULL;
 
+    for (unsigned int i = 0; i < SINOSCOPE_PHASE_COUNT; i++) {
+        sinoscope->phases[i] = -1;
+    }
+
+    memset(&sinoscope->cache, 0, sizeof(sinoscope->cache));
+    sinoscope->simd_columns = NULL;
+    memset(&sinoscope->adaptive, 0, sizeof(sinoscope->adaptive));
+
     return sinoscope;
 
 fail_free_sinoscope:
@@ -60,6 +237,13 @@ fail_exit:
 }
 
 void sinoscope_destroy(sinoscope_t* sinoscope) {
+    if (sinoscope->adaptive.low != NULL) {
+        sinoscope_destroy(sinoscope->adaptive.low);
+    }
+
+    /* rows, rows of the slots and dirty flags share the columns allocation */
+    free(sinoscope->cache.columns);
+    free(sinoscope->simd_columns);
     free(sinoscope->buffer);
     free(sinoscope);
 }
@@ -98,22 +282,160 @@ fail_exit:
     return -1;
 }
 
-static int compare_methods(sinoscope_t* serial, sinoscope_t* openmp, sinoscope_t* opencl) {
-    int status;
-    sinoscope_t *base;
-    sinoscope_t *compare;
-    long long max_diff;
+static unsigned int adaptive_scale(unsigned int level) {
+    return 1u << (level < ADAPTIVE_SCALE_LEVELS ? level : ADAPTIVE_SCALE_LEVELS);
+}
+
+static unsigned int adaptive_taylor(const sinoscope_t* sinoscope, unsigned int level) {
+    unsigned int shift = (level > ADAPTIVE_SCALE_LEVELS) ? level - ADAPTIVE_SCALE_LEVELS : 0;
+    unsigned int taylor = sinoscope->taylor >> shift;
+
+    return (taylor > 0) ? taylor : 1;
+}
+
+/* relative cost of a level, pixels times terms of the series */
+static float adaptive_cost(const sinoscope_t* sinoscope, unsigned int level) {
+    unsigned int scale = adaptive_scale(level);
+
+    return (float)((adaptive_taylor(sinoscope, level) + 1) / 2) / (scale * scale);
+}
+
+/* nearest neighbour, every row of `low` is widened once and copied to the next ones */
+static void adaptive_upscale(const sinoscope_t* low, sinoscope_t* sinoscope, unsigned int scale) {
+    const unsigned int pixel_size = sinoscope->pixel_size;
+    const size_t row_size         = sinoscope->width * pixel_size;
+
+    for (unsigned int j = 0; j < sinoscope->height; j++) {
+        unsigned char* row = &sinoscope->buffer[j * row_size];
+
+        if (j % scale != 0) {
+            memcpy(row, row - row_size, row_size);
+            continue;
+        }
+
+        const unsigned char* source = &low->buffer[(j / scale) * low->width * pixel_size];
+
+        for (unsigned int i = 0; i < sinoscope->width; i++) {
+            memcpy(&row[i * pixel_size], &source[(i / scale) * pixel_size], pixel_size);
+        }
+    }
+}
+
+static int adaptive_render(sinoscope_t* sinoscope, unsigned int level) {
+    sinoscope_adaptive_t* adaptive = &sinoscope->adaptive;
+    unsigned int scale             = adaptive_scale(level);
 
-    base = serial;
+    if (scale == 1) {
+        unsigned int taylor = sinoscope->taylor;
+        sinoscope->taylor   = adaptive_taylor(sinoscope, level);
 
-    if (openmp) {
-	    max_diff = 0;
-	    compare  = openmp;
+        int status        = sinoscope->handler(sinoscope);
+        sinoscope->taylor = taylor;
+
+        return status;
+    }
+
+    unsigned int width  = (sinoscope->width + scale - 1) / scale;
+    unsigned int height = (sinoscope->height + scale - 1) / scale;
+
+    if (adaptive->low != NULL && (adaptive->low->width != width || adaptive->low->height != height)) {
+        sinoscope_destroy(adaptive->low);
+        adaptive->low = NULL;
+    }
+
+    if (adaptive->low == NULL) {
+        adaptive->low = sinoscope_create((char*)sinoscope->name, sinoscope->handler, width, height, sinoscope->max,
+                                         sinoscope->format);
+        if (adaptive->low == NULL) {
+            LOG_ERROR("failed to create reduced sinoscope");
+            return -1;
+        }
+
+        adaptive->low->opencl = sinoscope->opencl;
+    }
+
+    /* same picture, the phases are not derived again from the smaller size */
+    sinoscope_t* low = adaptive->low;
+    low->name        = sinoscope->name;
+    low->handler     = sinoscope->handler;
+    low->precision   = sinoscope->precision;
+    low->taylor      = adaptive_taylor(sinoscope, level);
+    low->time        = sinoscope->time;
+    low->phase0      = sinoscope->phase0;
+    low->phase1      = sinoscope->phase1;
+
+    if (low->handler(low) < 0) {
+        return -1;
+    }
+
+    adaptive_upscale(low, sinoscope, scale);
+
+    return 0;
+}
+
+int sinoscope_render_adaptive(sinoscope_t* sinoscope) {
+    if (sinoscope == NULL) {
+        LOG_ERROR_NULL_PTR();
+        goto fail_exit;
+    }
+
+    sinoscope_adaptive_t* adaptive = &sinoscope->adaptive;
+
+    /* the pipelined handler keeps its own buffers of the full size */
+    if (adaptive->target_fps <= 0 || sinoscope->handler == sinoscope_image_opencl_async) {
+        return sinoscope->handler(sinoscope);
+    }
+
+    timespec_t start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (adaptive_render(sinoscope, adaptive->level) < 0) {
+        goto fail_exit;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    float elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    float budget  = 1 / adaptive->target_fps;
+    unsigned int level = adaptive->level;
+
+    bool lowest = adaptive_scale(level) == adaptive_scale(level + 1) &&
+                  adaptive_taylor(sinoscope, level) == adaptive_taylor(sinoscope, level + 1);
+
+    if (elapsed > budget) {
+        adaptive->fast_frames = 0;
+        if (!lowest && ++adaptive->slow_frames >= ADAPTIVE_SLOW_FRAMES) {
+            level++;
+        }
+    } else if (level > 0 && elapsed * adaptive_cost(sinoscope, level - 1) / adaptive_cost(sinoscope, level) <
+                                budget * ADAPTIVE_HEADROOM) {
+        adaptive->slow_frames = 0;
+        if (++adaptive->fast_frames >= ADAPTIVE_FAST_FRAMES) {
+            level--;
+        }
     } else {
-	    compare  = opencl;
-	    max_diff = 10;
+        adaptive->slow_frames = 0;
+        adaptive->fast_frames = 0;
     }
 
+    if (level != adaptive->level) {
+        adaptive->level       = level;
+        adaptive->slow_frames = 0;
+        adaptive->fast_frames = 0;
+
+        printf("Adaptive quality: 1/%u resolution, taylor %u\n", adaptive_scale(level),
+               adaptive_taylor(sinoscope, level));
+    }
+
+    return 0;
+
+fail_exit:
+    return -1;
+}
+
+static int compare_methods(sinoscope_t* base, sinoscope_t* compare, long long max_diff) {
+    int status;
+
     if (base->buffer_size != compare->buffer_size) {
         LOG_ERROR("buffer sizes mismatch");
         goto fail_exit;
@@ -129,8 +451,9 @@ static int compare_methods(sinoscope_t* serial, sinoscope_t* openmp, sinoscope_t
         goto fail_exit;
     }
 
-    status = base->handler(serial);
+    status = base->handler(base);
     status += compare->handler(compare);
+    status += sinoscope_opencl_drain(compare);
 
     if (status != 0) {
         LOG_ERROR("failed to call sinoscope handler");
@@ -153,58 +476,40 @@ fail_exit:
     return -1;
 }
 
-int sinoscope_check(unsigned int width, unsigned int height, unsigned int taylor, float max,
-                    sinoscope_opencl_t* opencl) {
-    sinoscope_t* sinoscope_serial = NULL;
-    sinoscope_t* sinoscope_openmp = NULL;
-    sinoscope_t* sinoscope_opencl = NULL;
+int sinoscope_check_handler(char* name, sinoscope_handler handler, unsigned int width, unsigned int height,
+                            unsigned int taylor, float max, sinoscope_format_t format, sinoscope_opencl_t* opencl,
+                            long long max_diff) {
+    sinoscope_t* sinoscope_serial  = NULL;
+    sinoscope_t* sinoscope_compare = NULL;
 
-    sinoscope_serial = sinoscope_create("serial", sinoscope_image_serial, width, height, max);
+    sinoscope_serial = sinoscope_create("serial", sinoscope_image_serial, width, height, max, format);
     if (sinoscope_serial == NULL) {
         LOG_ERROR("failed to create sinoscope (serial)");
         goto fail_exit;
     }
     sinoscope_serial->taylor = taylor;
 
-    if (!opencl) {
-    sinoscope_openmp = sinoscope_create("openmp", sinoscope_image_openmp, width, height, max);
-    if (sinoscope_openmp == NULL) {
-        LOG_ERROR("failed to create sinoscope (openmp)");
+    sinoscope_compare = sinoscope_create(name, handler, width, height, max, format);
+    if (sinoscope_compare == NULL) {
+        LOG_ERROR("failed to create sinoscope (%s)", name);
         goto fail_exit;
     }
-    sinoscope_openmp->taylor = taylor;
-    } else {
-    sinoscope_opencl = sinoscope_create("opencl", sinoscope_image_opencl, width, height, max);
-    if (sinoscope_opencl == NULL) {
-        LOG_ERROR("failed to create sinoscope (opencl)");
-        goto fail_exit;
-    }
-    sinoscope_opencl->taylor = taylor;
-    sinoscope_opencl->opencl = opencl;
-    }
+    sinoscope_compare->taylor = taylor;
+    sinoscope_compare->opencl = opencl;
 
     for (int i = 0; i < 10; i++) {
-        float time             = (((float)rand()) / ((float)RAND_MAX)) * (2 * M_PI * 1000);
-        sinoscope_serial->time = time;
-	if (!opencl) {
-		sinoscope_openmp->time = time;
-	} else {
-		sinoscope_opencl->time = time;
-	}
-
-        if (compare_methods(sinoscope_serial, sinoscope_openmp, sinoscope_opencl) < 0) {
+        float time              = (((float)rand()) / ((float)RAND_MAX)) * (2 * M_PI * 1000);
+        sinoscope_serial->time  = time;
+        sinoscope_compare->time = time;
+
+        if (compare_methods(sinoscope_serial, sinoscope_compare, max_diff) < 0) {
             LOG_ERROR("error when comparing results");
             goto fail_exit;
         }
     }
 
     sinoscope_destroy(sinoscope_serial);
-
-    if (!opencl) {
-    sinoscope_destroy(sinoscope_openmp);
-    } else {
-    sinoscope_destroy(sinoscope_opencl);
-    }
+    sinoscope_destroy(sinoscope_compare);
 
     return 0;
 
@@ -213,14 +518,190 @@ fail_exit:
         sinoscope_destroy(sinoscope_serial);
     }
 
-    if (sinoscope_openmp != NULL) {
-        sinoscope_destroy(sinoscope_openmp);
+    if (sinoscope_compare != NULL) {
+        sinoscope_destroy(sinoscope_compare);
     }
 
-    if (sinoscope_opencl != NULL) {
-        sinoscope_destroy(sinoscope_opencl);
+    return -1;
+}
+
+int sinoscope_check(unsigned int width, unsigned int height, unsigned int taylor, float max,
+                    sinoscope_opencl_t* opencl) {
+    const sinoscope_method_t* method = sinoscope_find_method(opencl ? "opencl" : "openmp");
+
+    return sinoscope_check_handler(method->name, method->handler, width, height, taylor, max,
+                                   SINOSCOPE_FORMAT_RGB8, opencl, method->max_diff);
+}
+
+/* host native only approximates the functions of float, it stays within the tolerance of the simd method */
+static const long long NATIVE_MAX_DIFF = 10;
+
+/*
+ * One precision of `method` against `reference`, OpenCL methods get a
+ * context built for it. Native is also held against `float_reference`, the
+ * serial version in float, on the host: OpenCL leaves the accuracy of its
+ * native functions to the device. The other precisions only report their
+ * error.
+ */
+static int check_precision(const sinoscope_method_t* method, sinoscope_precision_t precision, sinoscope_t* reference,
+                           sinoscope_t* float_reference, const sinoscope_opencl_t* opencl, unsigned int frames) {
+    sinoscope_opencl_t context;
+    memset(&context, 0, sizeof(context));
+
+    sinoscope_t* sinoscope = sinoscope_create(method->name, method->handler, reference->width, reference->height,
+                                              reference->max, SINOSCOPE_FORMAT_RGB8);
+    if (sinoscope == NULL) {
+        LOG_ERROR("failed to create sinoscope (%s)", method->name);
+        goto fail_exit;
     }
+    sinoscope->taylor    = reference->taylor;
+    sinoscope->precision = precision;
+
+    if (method->opencl) {
+        context.memory        = opencl->memory;
+        context.local_size[0] = opencl->local_size[0];
+        context.local_size[1] = opencl->local_size[1];
+        context.precision     = precision;
+
+        /* double precision is optional on OpenCL devices */
+        if (sinoscope_opencl_init(&context, opencl->device_id, sinoscope->width, sinoscope->height) < 0) {
+            printf("%-10s   not supported by the device\n", sinoscope_precision_name(precision));
+            sinoscope_opencl_cleanup(&context);
+            sinoscope_destroy(sinoscope);
+            return 0;
+        }
 
+        sinoscope->opencl = &context;
+    }
+
+    long long max_diff        = 0;
+    long long native_max_diff = 0;
+    double total_diff         = 0;
+    double elapsed            = 0;
+
+    for (unsigned int i = 0; i < frames; i++) {
+        /* spread over the whole period of the animation, every precision sees the same frames */
+        reference->time = sinoscope->time = float_reference->time = (2 * M_PI * 1000) * i / frames;
+
+        if (sinoscope_corners(reference) < 0 || sinoscope_corners(sinoscope) < 0) {
+            LOG_ERROR("failed to forward sinoscope");
+            goto fail_destroy_sinoscope;
+        }
+
+        if (reference->handler(reference) < 0) {
+            LOG_ERROR("failed to call sinoscope handler `%s`", reference->name);
+            goto fail_destroy_sinoscope;
+        }
+
+        timespec_t start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        if (sinoscope->handler(sinoscope) < 0 || sinoscope_opencl_drain(sinoscope) < 0) {
+            LOG_ERROR("failed to call sinoscope handler `%s`", sinoscope->name);
+            goto fail_destroy_sinoscope;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+        for (unsigned int j = 0; j < sinoscope->buffer_size; j++) {
+            long long diff = llabs((long long)sinoscope->buffer[j] - reference->buffer[j]);
+
+            max_diff = (diff > max_diff) ? diff : max_diff;
+            total_diff += diff;
+        }
+
+        if (precision != SINOSCOPE_PRECISION_NATIVE || method->opencl) {
+            continue;
+        }
+
+        if (sinoscope_corners(float_reference) < 0 || float_reference->handler(float_reference) < 0) {
+            LOG_ERROR("failed to call sinoscope handler `%s`", float_reference->name);
+            goto fail_destroy_sinoscope;
+        }
+
+        for (unsigned int j = 0; j < sinoscope->buffer_size; j++) {
+            long long diff  = llabs((long long)sinoscope->buffer[j] - float_reference->buffer[j]);
+            native_max_diff = (diff > native_max_diff) ? diff : native_max_diff;
+        }
+    }
+
+    printf("%-10s   %8lld   %9.4f   %10.1f\n", sinoscope_precision_name(precision), max_diff,
+           total_diff / ((double)sinoscope->buffer_size * frames), elapsed / frames * 1e6);
+
+    if (native_max_diff > NATIVE_MAX_DIFF) {
+        LOG_ERROR("native differs by %lld from float, more than %lld", native_max_diff, NATIVE_MAX_DIFF);
+        goto fail_destroy_sinoscope;
+    }
+
+    if (method->opencl) {
+        sinoscope_opencl_cleanup(&context);
+    }
+    sinoscope_destroy(sinoscope);
+
+    return 0;
+
+fail_destroy_sinoscope:
+    if (method->opencl) {
+        sinoscope_opencl_cleanup(&context);
+    }
+    sinoscope_destroy(sinoscope);
+fail_exit:
+    return -1;
+}
+
+int sinoscope_check_precision(const sinoscope_method_t* method, unsigned int width, unsigned int height,
+                              unsigned int taylor, float max, const sinoscope_opencl_t* opencl, unsigned int frames) {
+    if (method->opencl && opencl == NULL) {
+        LOG_ERROR("method `%s` requires an OpenCL device", method->name);
+        goto fail_exit;
+    }
+
+    if (!method->precisions) {
+        LOG_ERROR("method `%s` only renders the default precision", method->name);
+        goto fail_exit;
+    }
+
+    sinoscope_t* reference = sinoscope_create("serial", sinoscope_image_serial, width, height, max,
+                                              SINOSCOPE_FORMAT_RGB8);
+    if (reference == NULL) {
+        LOG_ERROR("failed to create sinoscope (serial)");
+        goto fail_exit;
+    }
+    reference->taylor    = taylor;
+    reference->precision = SINOSCOPE_PRECISION_DOUBLE;
+
+    sinoscope_t* float_reference = sinoscope_create("serial", sinoscope_image_serial, width, height, max,
+                                                    SINOSCOPE_FORMAT_RGB8);
+    if (float_reference == NULL) {
+        LOG_ERROR("failed to create sinoscope (serial)");
+        sinoscope_destroy(reference);
+        goto fail_exit;
+    }
+    float_reference->taylor    = taylor;
+    float_reference->precision = SINOSCOPE_PRECISION_FLOAT;
+
+    printf("=========================================================================\n");
+    printf("precision of %s against serial in double, %u frames of %ux%u\n", method->name, frames, width, height);
+    printf("precision    max diff   mean diff   frame (us)\n");
+
+    for (unsigned int precision = 0; precision < SINOSCOPE_PRECISION_COUNT; precision++) {
+        if (check_precision(method, precision, reference, float_reference, opencl, frames) < 0) {
+            LOG_ERROR("failed to check precision `%s`", sinoscope_precision_name(precision));
+            sinoscope_destroy(float_reference);
+            sinoscope_destroy(reference);
+            goto fail_exit;
+        }
+    }
+
+    printf("=========================================================================\n");
+
+    sinoscope_destroy(float_reference);
+    sinoscope_destroy(reference);
+
+    return 0;
+
+fail_exit:
     return -1;
 }
 
@@ -238,7 +719,46 @@ static uint64_t timeval_diff_us(timeval_t* t1, timeval_t* t2) {
     return (t1_us > t2_us) ? (t1_us - t2_us) : (t2_us - t1_us);
 }
 
+static int compare_samples(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+/* sorts the samples, the p99 is the smallest sample above 99% of the others */
+static void print_distribution(const char* name, double* samples, unsigned int count) {
+    qsort(samples, count, sizeof(*samples), compare_samples);
+
+    unsigned int p99 = (count * 99 + 99) / 100;
+
+    printf("    %-10s min %10.1f   median %10.1f   p99 %10.1f   (us, %u frames)\n", name, samples[0],
+           samples[count / 2], samples[p99 - 1], count);
+}
+
+/* frame times followed by every phase, `iterations` samples each */
+static void print_profile(double* samples, const unsigned int* counts, unsigned int iterations) {
+    print_distribution("frame", samples, iterations);
+
+    for (unsigned int phase = 0; phase < SINOSCOPE_PHASE_COUNT; phase++) {
+        if (counts[phase] > 0) {
+            print_distribution(sinoscope_phase_name(phase), &samples[(phase + 1) * iterations], counts[phase]);
+        }
+    }
+}
+
 int sinoscope_benchmark(sinoscope_t* sinoscope, unsigned int iterations) {
+    double* samples                           = NULL;
+    unsigned int counts[SINOSCOPE_PHASE_COUNT] = {0};
+
+    if (sinoscope_profile) {
+        samples = malloc((SINOSCOPE_PHASE_COUNT + 1) * iterations * sizeof(*samples));
+        if (samples == NULL) {
+            LOG_ERROR_ERRNO("malloc");
+            goto fail_exit;
+        }
+    }
+
     timespec_t start_time;
     if (clock_gettime(CLOCK_MONOTONIC, &start_time) < 0) {
         LOG_ERROR_ERRNO("clock_gettime");
@@ -257,10 +777,36 @@ int sinoscope_benchmark(sinoscope_t* sinoscope, unsigned int iterations) {
             goto fail_exit;
         }
 
+        for (unsigned int phase = 0; phase < SINOSCOPE_PHASE_COUNT; phase++) {
+            sinoscope->phases[phase] = -1;
+        }
+
+        timespec_t frame_start, frame_end;
+        clock_gettime(CLOCK_MONOTONIC, &frame_start);
+
         if (sinoscope->handler(sinoscope) < 0) {
             LOG_ERROR("failed to call sinoscope handler `%s`", sinoscope->name);
             goto fail_exit;
         }
+
+        if (samples == NULL) {
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &frame_end);
+        samples[i] = timespec_diff_us(&frame_start, &frame_end);
+
+        for (unsigned int phase = 0; phase < SINOSCOPE_PHASE_COUNT; phase++) {
+            if (sinoscope->phases[phase] >= 0) {
+                samples[(phase + 1) * iterations + counts[phase]++] = sinoscope->phases[phase];
+            }
+        }
+    }
+
+    /* pipelined handlers still have the last frame in flight */
+    if (sinoscope_opencl_drain(sinoscope) < 0) {
+        LOG_ERROR("failed to drain sinoscope `%s`", sinoscope->name);
+        goto fail_exit;
     }
 
     timespec_t end_time;
@@ -282,81 +828,68 @@ int sinoscope_benchmark(sinoscope_t* sinoscope, unsigned int iterations) {
     printf("%s\t%5d    %5u    %8u  %10lu   %10lu    %10lu\n", sinoscope->name, sinoscope->width, sinoscope->height,
            iterations, utime, stime, elapsed);
 
+    if (samples != NULL) {
+        print_profile(samples, counts, iterations);
+        free(samples);
+    }
+
     return 0;
 
 fail_exit:
+    free(samples);
     return -1;
 }
 
 int sinoscope_benchmarks(unsigned int width, unsigned int height, unsigned int taylor, float max,
-                        sinoscope_opencl_t* opencl, unsigned int iterations) {
-    sinoscope_t* sinoscope_serial = NULL;
-    sinoscope_t* sinoscope_openmp = NULL;
-    sinoscope_t* sinoscope_opencl = NULL;
-
-    sinoscope_serial = sinoscope_create("serial", sinoscope_image_serial, width, height, max);
-    if (sinoscope_serial == NULL) {
-        LOG_ERROR("failed to create sinoscope (serial)");
-        goto fail_exit;
-    }
-    sinoscope_serial->taylor = taylor;
-
-    sinoscope_openmp = sinoscope_create("openmp", sinoscope_image_openmp, width, height, max);
-    if (sinoscope_openmp == NULL) {
-        LOG_ERROR("failed to create sinoscope (openmp)");
-        goto fail_exit;
-    }
-    sinoscope_openmp->taylor = taylor;
-
-    sinoscope_opencl = sinoscope_create("opencl", sinoscope_image_opencl, width, height, max);
-    if (sinoscope_opencl == NULL) {
-        LOG_ERROR("failed to create sinoscope (opencl)");
-        goto fail_exit;
-    }
-    sinoscope_opencl->taylor = taylor;
-    sinoscope_opencl->opencl = opencl;
-
+                        sinoscope_format_t format, sinoscope_opencl_t* opencl, unsigned int iterations) {
     printf("=========================================================================\n");
     printf("=========================== benchmark results ===========================\n");
     printf("=========================================================================\n");
     printf("test    width   height  iterations   user (us)  system (us)  elapsed (us)\n");
 
-    if (sinoscope_benchmark(sinoscope_serial, iterations) < 0) {
-        LOG_ERROR("failed to benchmark (serial)");
-        goto fail_exit;
-    }
+    printf("buffer format: %s\n", sinoscope_format_name(format));
+    printf("precision: %s\n", sinoscope_precision_name(sinoscope_precision));
 
-    if (sinoscope_benchmark(sinoscope_openmp, iterations) < 0) {
-        LOG_ERROR("failed to benchmark (openmp)");
-        goto fail_exit;
-    }
+    if (opencl != NULL) {
+        printf("opencl host memory: %s\n", sinoscope_opencl_memory_name(opencl->memory));
 
-    if (sinoscope_benchmark(sinoscope_opencl, iterations) < 0) {
-        LOG_ERROR("failed to benchmark (opencl)");
-        goto fail_exit;
+        if (opencl->local_size[0] == 0) {
+            printf("opencl local size: runtime\n");
+        } else {
+            printf("opencl local size: %zux%zu\n", opencl->local_size[0], opencl->local_size[1]);
+        }
     }
 
-    printf("=========================================================================\n");
+    for (unsigned int i = 0; i < sinoscope_method_count; i++) {
+        const sinoscope_method_t* method = &sinoscope_methods[i];
 
-    sinoscope_destroy(sinoscope_serial);
-    sinoscope_destroy(sinoscope_openmp);
-    sinoscope_destroy(sinoscope_opencl);
+        if ((method->opencl && opencl == NULL) || !sinoscope_method_supports(method, format) ||
+            !sinoscope_method_renders(method, sinoscope_precision)) {
+            continue;
+        }
 
-    return 0;
+        sinoscope_t* sinoscope = sinoscope_create(method->name, method->handler, width, height, max, format);
+        if (sinoscope == NULL) {
+            LOG_ERROR("failed to create sinoscope (%s)", method->name);
+            goto fail_exit;
+        }
+        sinoscope->taylor = taylor;
+        sinoscope->opencl = opencl;
 
-fail_exit:
-    if (sinoscope_serial != NULL) {
-        sinoscope_destroy(sinoscope_serial);
-    }
+        int status = sinoscope_benchmark(sinoscope, iterations);
+        sinoscope_destroy(sinoscope);
 
-    if (sinoscope_openmp != NULL) {
-        sinoscope_destroy(sinoscope_openmp);
+        if (status < 0) {
+            LOG_ERROR("failed to benchmark (%s)", method->name);
+            goto fail_exit;
+        }
     }
 
-    if (sinoscope_opencl != NULL) {
-        sinoscope_destroy(sinoscope_opencl);
-    }
+    printf("=========================================================================\n");
+
+    return 0;
 
+fail_exit:
     return -1;
 }
 
@@ -371,38 +904,19 @@ int sinoscope_save_image(sinoscope_t* sinoscope, char* filename) {
         goto fail_exit;
     }
 
-    image_t* image = image_create(sinoscope->width, sinoscope->height);
-    if (image == NULL) {
-        LOG_ERROR("failed to create image");
+    if (sinoscope_opencl_drain(sinoscope) < 0) {
+        LOG_ERROR("failed to drain sinoscope `%s`", sinoscope->name);
         goto fail_exit;
     }
 
-    for (int j = 0; j < sinoscope->height; j++) {
-        for (int i = 0; i < sinoscope->width; i++) {
-            pixel_t* pixel = image_get_pixel(image, i, j);
-            if (pixel == NULL) {
-                LOG_ERROR("failed to get pixel");
-                goto fail_free_image;
-            }
-
-            unsigned int index = (i * 3) + (j * 3) * sinoscope->width;
-            pixel->bytes[0] = sinoscope->buffer[index + 0];
-            pixel->bytes[1] = sinoscope->buffer[index + 1];
-            pixel->bytes[2] = sinoscope->buffer[index + 2];
-        }
-    }
-
-    if (image_save_png(image, filename) < 0) {
+    if (image_save_png_packed(sinoscope->buffer, sinoscope->width, sinoscope->height, sinoscope->pixel_size,
+                              filename) < 0) {
         LOG_ERROR("failed to save image");
-        goto fail_free_image;
+        goto fail_exit;
     }
 
-    image_destroy(image);
-
     return 0;
 
-fail_free_image:
-    image_destroy(image);
 fail_exit:
     return -1;
 }
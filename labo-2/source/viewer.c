@@ -1,5 +1,7 @@
 /* DO NOT EDIT THIS FILE */
 
+#include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <time.h>
@@ -10,6 +12,7 @@
 
 #include <GL/freeglut_ext.h>
 
+#include "frame-ring.h"
 #include "log.h"
 #include "sinoscope.h"
 #include "viewer.h"
@@ -25,6 +28,12 @@ typedef struct viewer {
     GLuint texture;
     bool enabled;
 
+    /* rendering runs on its own thread, the GL thread only uploads the latest frame */
+    frame_ring_t ring;
+    unsigned char* buffer;
+    pthread_t render_thread;
+    bool exit;
+
     long fps_count;
     timespec_t fps_start;
 } viewer_t;
@@ -59,6 +68,14 @@ int viewer_init(sinoscope_t* sinoscope) {
         goto fail_free_viewer;
     }
 
+    if (frame_ring_init(&viewer->ring, sinoscope->buffer_size) < 0) {
+        LOG_ERROR("failed to initialise frame ring");
+        goto fail_free_viewer;
+    }
+
+    viewer->buffer = sinoscope->buffer;
+    viewer->exit   = false;
+
     return 0;
 
 fail_free_viewer:
@@ -70,11 +87,45 @@ fail_exit:
 
 void viewer_destroy() {
     if (viewer != NULL) {
+        viewer->sinoscope->buffer = viewer->buffer;
+        frame_ring_destroy(&viewer->ring);
         free(viewer);
         viewer = NULL;
     }
 }
 
+static void* render_thread_loop(void* data) {
+    (void)data;
+
+    sinoscope_t* sinoscope = viewer->sinoscope;
+    bool exit              = false;
+
+    while (!exit) {
+        if (sinoscope_corners(sinoscope) < 0) {
+            LOG_ERROR("failed to forward sinoscope");
+        }
+
+        unsigned char* back = frame_ring_back(&viewer->ring);
+        sinoscope->buffer   = back;
+
+        if (sinoscope_render_adaptive(sinoscope) < 0) {
+            LOG_ERROR("failed to call sinoscope handler `%s`\n", sinoscope->name);
+        }
+
+        /* the async handler, or the drain when leaving it, hands over a completed buffer */
+        if (sinoscope->buffer != back) {
+            frame_ring_adopt_back(&viewer->ring, sinoscope->buffer);
+        }
+
+        frame_ring_publish(&viewer->ring);
+        __atomic_fetch_add(&viewer->fps_count, 1, __ATOMIC_RELAXED);
+
+        __atomic_load(&viewer->exit, &exit, __ATOMIC_ACQUIRE);
+    }
+
+    return NULL;
+}
+
 static int pre_display() {
     if (viewer == NULL) {
         LOG_ERROR("viewer has not been initialised");
@@ -125,15 +176,8 @@ static int display() {
         goto fail_exit;
     }
 
-    if (sinoscope_corners(viewer->sinoscope) < 0) {
-        LOG_ERROR("failed to forward sinoscope");
-        goto fail_exit;
-    }
-
-    if (viewer->sinoscope->handler(viewer->sinoscope) < 0) {
-        LOG_ERROR("failed to call sinoscope handler `%s`\n", viewer->sinoscope->name);
-        goto fail_exit;
-    }
+    bool fresh;
+    const unsigned char* frame = frame_ring_acquire(&viewer->ring, &fresh);
 
     if (viewer->texture == 0) {
         glGenTextures(1, &viewer->texture);
@@ -148,10 +192,14 @@ static int display() {
             goto fail_exit;
         }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, 3, viewer->sinoscope->width, viewer->sinoscope->height, 0, GL_RGB,
-                     GL_UNSIGNED_BYTE, viewer->sinoscope->buffer);
-        if (LOG_ERROR_OPENGL("glTexImage2D") < 0) {
-            goto fail_exit;
+        /* a duplicated frame is already in the texture */
+        if (fresh) {
+            bool rgba = viewer->sinoscope->format == SINOSCOPE_FORMAT_RGBA8;
+            glTexImage2D(GL_TEXTURE_2D, 0, rgba ? GL_RGBA : GL_RGB, viewer->sinoscope->width,
+                         viewer->sinoscope->height, 0, rgba ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, frame);
+            if (LOG_ERROR_OPENGL("glTexImage2D") < 0) {
+                goto fail_exit;
+            }
         }
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -185,8 +233,6 @@ static int display() {
         }
     }
 
-    viewer->fps_count++;
-
     return 0;
 
 fail_exit:
@@ -233,13 +279,25 @@ void callback_timer_fps(int value) {
     float end_sec   = fps_end.tv_sec + fps_end.tv_nsec / 1e9;
     float diff_sec  = end_sec - start_sec;
 
-    printf("FPS: %2.2f\n", (float)viewer->fps_count / diff_sec);
-    viewer->fps_count = 0;
+    long fps_count = __atomic_exchange_n(&viewer->fps_count, 0, __ATOMIC_RELAXED);
+    long dropped, duplicated;
+    frame_ring_counters(&viewer->ring, &dropped, &duplicated);
+
+    printf("FPS: %2.2f (dropped: %ld, duplicated: %ld)\n", (float)fps_count / diff_sec, dropped, duplicated);
     viewer->fps_start = fps_end;
 
     glutTimerFunc(fps_delay_ms, callback_timer_fps, 0);
 }
 
+static void select_method(sinoscope_t* sinoscope, const char* name) {
+    if (sinoscope_select_method(sinoscope, name) < 0) {
+        printf("Method %s cannot render this frame, keeping %s\n", name, sinoscope->name);
+        return;
+    }
+
+    printf("Selected %s implementation\n", name);
+}
+
 void callback_keyboard(unsigned char key, int x, int y) {
     if (viewer == NULL) {
         LOG_ERROR("viewer has not been initialised");
@@ -252,19 +310,16 @@ void callback_keyboard(unsigned char key, int x, int y) {
         glutLeaveMainLoop();
         break;
     case '1':
-        printf("Selected serial implementation\n");
-        viewer->sinoscope->name    = "serial";
-        viewer->sinoscope->handler = sinoscope_image_serial;
+        select_method(viewer->sinoscope, "serial");
         break;
     case '2':
-        printf("Selected openmp implementation\n");
-        viewer->sinoscope->name    = "openmp";
-        viewer->sinoscope->handler = sinoscope_image_openmp;
+        select_method(viewer->sinoscope, "openmp");
         break;
     case '3':
-        printf("Selected opencl implementation\n");
-        viewer->sinoscope->name    = "opencl";
-        viewer->sinoscope->handler = sinoscope_image_opencl;
+        select_method(viewer->sinoscope, "opencl");
+        break;
+    case '4':
+        select_method(viewer->sinoscope, "simd");
         break;
     case ' ':
         printf("Rendering %s\n", viewer->enabled ? "disabled" : "enabled");
@@ -317,10 +372,28 @@ int viewer_open() {
     glutKeyboardFunc(callback_keyboard);
     glutReshapeFunc(callback_reshape);
 
+    /* the render thread is joined once the main loop returns instead of running into exit() */
+    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
+
     glewInit();
     glXSwapIntervalSGI(0);
+
+    errno = pthread_create(&viewer->render_thread, NULL, render_thread_loop, NULL);
+    if (errno != 0) {
+        LOG_ERROR_ERRNO("pthread_create");
+        goto fail_exit;
+    }
+
     glutMainLoop();
 
+    bool value = true;
+    __atomic_store(&viewer->exit, &value, __ATOMIC_RELEASE);
+
+    errno = pthread_join(viewer->render_thread, NULL);
+    if (errno != 0) {
+        LOG_ERROR_ERRNO("pthread_join");
+    }
+
     return 0;
 
 fail_exit: